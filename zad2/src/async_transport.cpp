@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <utility>
+
+#include "async_transport.h"
+
+AsyncTransport::AsyncTransport(Session session) : session(std::move(session)) {
+}
+
+void AsyncTransport::start(Clock::time_point now) {
+    current = now;
+    task.emplace(session(*this));
+    task->start();
+    if (task->done()) {
+        finish(task->result());
+    }
+}
+
+void AsyncTransport::feed(std::span<const uint8_t> data, Clock::time_point now) {
+    if (finished()) {
+        return;
+    }
+    input.insert(input.end(), data.begin(), data.end());
+    resume(now);
+}
+
+AsyncTransport::WriteOperation AsyncTransport::write(std::span<const uint8_t> data) {
+    if (finished()) {
+        return {-1};
+    }
+    send(data);
+    return {static_cast<int>(data.size())};
+}
+
+void AsyncTransport::expired(Clock::time_point now) {
+    resume(now);
+}
+
+// Przerwane łącze budzi korutynę czekającą na odczyt - dostaje -1 i sama kończy sesję
+void AsyncTransport::completed(bool) {
+    resume(current);
+}
+
+int AsyncTransport::take(std::span<uint8_t> data) {
+    size_t count = std::min(available(), data.size());
+    if (count == 0) {
+        return finished() ? -1 : 0;
+    }
+    std::copy_n(input.begin() + consumed, count, data.begin());
+    consumed += count;
+    if (consumed == input.size()) {
+        input.clear();
+        consumed = 0;
+    }
+    return static_cast<int>(count);
+}
+
+// Wznawia korutynę czekającą na odczyt; gdy sesja dobiegła końca, kończy też maszynę
+void AsyncTransport::resume(Clock::time_point now) {
+    current = now;
+    if (waiting) {
+        arm(Clock::time_point::max());
+        std::exchange(waiting, nullptr).resume();
+    }
+    if (task && task->done()) {
+        finish(task->result());
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef ASYNC_TRANSPORT_H
+#define ASYNC_TRANSPORT_H
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "protocol_machine.h"
+#include "task.h"
+
+// Łącze dla korutyn: sesja pisana jak blokujący kod z Transport, ale czekająca przez co_await. Na
+// zewnątrz to zwykła maszyna protokołu, więc tysiące sesji obsługuje kilka wątków pętli zdarzeń,
+// które wznawiają korutynę, gdy przyjdą dane albo minie termin odczytu.
+class AsyncTransport : public ProtocolMachine {
+public:
+    using Session = std::function<Task<bool>(AsyncTransport&)>;
+
+    explicit AsyncTransport(Session session);
+
+    void start(Clock::time_point now) override;
+    void feed(std::span<const uint8_t> data, Clock::time_point now) override;
+
+    struct ReadOperation {
+        AsyncTransport& link;
+        std::span<uint8_t> data;
+        Clock::time_point deadline;
+
+        bool await_ready() const {
+            return link.available() > 0 || link.finished() || deadline <= link.current;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            link.waiting = handle;
+            link.arm(deadline);
+        }
+        int await_resume() {
+            return link.take(data);
+        }
+    };
+
+    struct WriteOperation {
+        int result;
+
+        bool await_ready() const {
+            return true;
+        }
+        void await_suspend(std::coroutine_handle<>) {
+        }
+        int await_resume() const {
+            return result;
+        }
+    };
+
+    // Jak Transport::read: od 1 do data.size() bajtów, 0 gdy nic nie przyszło przed deadline,
+    // -1 gdy łącze zostało zamknięte
+    ReadOperation read(std::span<uint8_t> data, Clock::time_point deadline) {
+        return {*this, data, deadline};
+    }
+    // Bajty od razu trafiają do output(); zwraca ich liczbę albo -1 po zamknięciu łącza
+    WriteOperation write(std::span<const uint8_t> data);
+    // Czas ostatniego zdarzenia, od którego korutyna liczy swoje terminy
+    Clock::time_point now() const {
+        return current;
+    }
+
+protected:
+    void expired(Clock::time_point now) override;
+    void completed(bool result) override;
+
+private:
+    size_t available() const {
+        return input.size() - consumed;
+    }
+    int take(std::span<uint8_t> data);
+    void resume(Clock::time_point now);
+
+    Session session;
+    std::optional<Task<bool>> task;
+    std::coroutine_handle<> waiting;
+    std::vector<uint8_t> input;
+    size_t consumed = 0;
+    Clock::time_point current;
+};
+
+#endif
@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loopback.h"
+#include "xmodem.h"
+#include "xmodem_coroutine.h"
+#include "xmodem_machine.h"
+#include "zmodem.h"
+
+// Ostatni KiB danych testowych jest niepełny, żeby sprawdzić dopełnienie i jego obcinanie
+#define BENCH_TAIL_SIZE 100
+// Początek pliku, który zostaje po przerwanej transmisji ZMODEM
+#define BENCH_PARTIAL_SIZE 50000
+
+// Licznik alokacji całego procesu - pozwala sprawdzić, że ustalona transmisja nie alokuje na każdy blok
+std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+// Przepuszcza wywołania do łącza i zlicza odczyty, czyli odpowiedniki wywołań systemowych na porcie
+class CountingTransport : public Transport {
+public:
+    explicit CountingTransport(Transport& link) : link(link) {
+    }
+
+    int read(uint8_t* data, size_t count, Clock::time_point deadline) override {
+        reads++;
+        return link.read(data, count, deadline);
+    }
+    int write(const uint8_t* data, size_t count) override {
+        return link.write(data, count);
+    }
+    int writeGather(std::span<const std::span<const uint8_t>> buffers) override {
+        return link.writeGather(buffers);
+    }
+    void flush() override {
+        link.flush();
+    }
+
+    size_t reads = 0;
+
+private:
+    Transport& link;
+};
+
+// Łącze, które zrywa się po cutAfter bajtach odebranych przez tę stronę. Obie strony dzielą flagę cut,
+// więc od tej chwili ich odczyty i zapisy zwracają -1, jak po wyjęciu kabla. Bez cutAfter tylko liczy
+// odebrane bajty.
+class CutTransport : public Transport {
+public:
+    CutTransport(Transport& link, std::atomic<bool>& cut, uint64_t cutAfter = UINT64_MAX)
+        : link(link), cut(cut), cutAfter(cutAfter) {
+    }
+
+    int read(uint8_t* data, size_t count, Clock::time_point deadline) override {
+        if (cut) {
+            return -1;
+        }
+        int result = link.read(data, static_cast<size_t>(std::min<uint64_t>(count, cutAfter - received)), deadline);
+        if (result > 0) {
+            received += result;
+            if (received >= cutAfter) {
+                cut = true;
+            }
+        }
+        return result;
+    }
+    int write(const uint8_t* data, size_t count) override {
+        return cut ? -1 : link.write(data, count);
+    }
+    int writeGather(std::span<const std::span<const uint8_t>> buffers) override {
+        return cut ? -1 : link.writeGather(buffers);
+    }
+    void flush() override {
+        link.flush();
+    }
+
+    uint64_t received = 0;
+
+private:
+    Transport& link;
+    std::atomic<bool>& cut;
+    uint64_t cutAfter;
+};
+
+struct BenchMode {
+    const char* name;
+    bool crc;
+    bool oneK;
+    int window;
+    bool streaming;
+    bool zmodem;
+    bool crc32;
+    // więcej niż jedno łącze to przesyłanie fragmentów pliku równolegle przez wszystkie
+    size_t links;
+    bool trimPadding;
+};
+
+const BenchMode modes[] = {
+    {"suma kontrolna", false, false, 0, false, false, false, 1, false},
+    {"CRC16", true, false, 0, false, false, false, 1, false},
+    {"XMODEM-1K", true, true, 0, false, false, false, 1, false},
+    {"1K, bez 0x1A", true, true, 0, false, false, false, 1, true},
+    {"1K, CRC-32C", true, true, 0, false, false, true, 1, false},
+    {"1K, okno 16", true, true, 16, false, false, false, 1, false},
+    {"XMODEM-G 1K", true, true, 0, true, false, false, 1, false},
+    {"ZMODEM", true, true, 0, false, true, false, 1, false},
+    {"1K, 4 porty", true, true, 0, false, false, false, 4, false},
+};
+
+std::vector<uint8_t> readWholeFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Dane testowe kończą się fragmentem krótszym niż 128 bajtów. Odbiornik, który nie zna długości pliku,
+// zapisuje go dopełnionego 0x1A do granicy bloku; exact oznacza, że dopełnienia ma nie być wcale.
+bool outputMatches(const std::vector<uint8_t>& input, const std::vector<uint8_t>& output, bool exact) {
+    size_t expected = exact ? input.size() : (input.size() + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    return output.size() == expected && std::equal(input.begin(), input.end(), output.begin())
+        && std::all_of(output.begin() + input.size(), output.end(), [](uint8_t byte) { return byte == 0x1A; });
+}
+
+struct MachinePairing {
+    const char* name;
+    bool coroutineSender;
+    bool coroutineReceiver;
+};
+
+const MachinePairing pairings[] = {
+    {"maszyny", false, false},
+    {"korutyny", true, true},
+    {"korutyna-maszyna", true, false},
+    {"maszyna-korutyna", false, true},
+};
+
+// Łączy nadawcę i odbiornik bez wątków i prawdziwego czasu - jako maszyny stanów albo korutyny na
+// AsyncTransport: bajty przechodzą między nimi w pamięci, co corruptEvery bajtów jeden jest przekłamany,
+// a gdy obie strony czekają, zegar przeskakuje do najbliższego terminu. Zwraca liczbę przekłamań
+// albo -1, gdy dane się nie zgadzają.
+long runMachines(const TransferOptions& options, const MachinePairing& pairing, const std::vector<uint8_t>& input,
+                 size_t corruptEvery) {
+    size_t offset = 0;
+    BlockSource source = [&](std::span<uint8_t> buffer) {
+        size_t count = std::min(buffer.size(), input.size() - offset);
+        std::copy_n(input.begin() + offset, count, buffer.begin());
+        offset += count;
+        return count;
+    };
+    std::vector<uint8_t> output;
+    BlockSink sink = [&](std::span<const uint8_t> block) {
+        output.insert(output.end(), block.begin(), block.end());
+        return true;
+    };
+
+    std::unique_ptr<ProtocolMachine> senderMachine;
+    if (pairing.coroutineSender) {
+        senderMachine = std::make_unique<AsyncTransport>([&](AsyncTransport& link) {
+            return sendXmodem(link, options, source);
+        });
+    } else {
+        senderMachine = std::make_unique<NegotiatingXmodemSender>(options, source);
+    }
+    std::unique_ptr<ProtocolMachine> receiverMachine;
+    if (pairing.coroutineReceiver) {
+        receiverMachine = std::make_unique<AsyncTransport>([&](AsyncTransport& link) {
+            return receiveXmodem(link, options, sink);
+        });
+    } else {
+        receiverMachine = makeXmodemReceiver(options, sink);
+    }
+    ProtocolMachine& sender = *senderMachine;
+    ProtocolMachine& receiver = *receiverMachine;
+
+    long corrupted = 0;
+    size_t carried = 0;
+    auto deliver = [&](ProtocolMachine& from, ProtocolMachine& to, ProtocolMachine::Clock::time_point now) {
+        std::vector<uint8_t> data;
+        data.swap(from.output());
+        for (auto& byte : data) {
+            if (++carried % corruptEvery == 0) {
+                byte ^= 0x55;
+                corrupted++;
+            }
+        }
+        if (!data.empty()) {
+            to.feed(data, now);
+        }
+        return !data.empty();
+    };
+
+    ProtocolMachine::Clock::time_point now{};
+    receiver.start(now);
+    sender.start(now);
+    while (!sender.finished() || !receiver.finished()) {
+        bool moved = deliver(receiver, sender, now);
+        moved = deliver(sender, receiver, now) || moved;
+        if (!moved) {
+            now = std::min(sender.deadline(), receiver.deadline());
+            if (now == ProtocolMachine::Clock::time_point::max()) {
+                break;
+            }
+            sender.poll(now);
+            receiver.poll(now);
+        }
+    }
+
+    bool correct = sender.succeeded() && receiver.succeeded() && outputMatches(input, output, false);
+    return correct ? corrupted : -1;
+}
+
+struct TransferResult {
+    bool correct;
+    double seconds;
+    size_t allocations;
+    size_t reads;
+};
+
+// Przesyła input przez łącza pętli zwrotnej w jednym z trybów i sprawdza plik po stronie odbiornika
+TransferResult runTransfer(const BenchMode& mode, const LinkParameters& link, const std::vector<uint8_t>& input,
+                           const std::filesystem::path& inputPath, const std::filesystem::path& outputPath) {
+    TransferOptions options;
+    options.crc = mode.crc;
+    options.oneK = mode.oneK;
+    options.windowSize = mode.window;
+    options.streaming = mode.streaming;
+    options.crc32 = mode.crc32;
+    options.trimPadding = mode.trimPadding;
+
+    std::ofstream(inputPath, std::ios::binary).write(reinterpret_cast<const char*>(input.data()), input.size());
+    // ZMODEM wznowiłby transmisję od pliku z poprzedniego przebiegu
+    std::filesystem::remove(outputPath);
+
+    std::vector<std::unique_ptr<LoopbackTransport>> senderEnds;
+    std::vector<std::unique_ptr<LoopbackTransport>> receiverEnds;
+    std::vector<std::unique_ptr<CountingTransport>> receiverLinks;
+    std::vector<Transport*> senderLinks;
+    std::vector<Transport*> receiverLinkPointers;
+    for (size_t i = 0; i < mode.links; ++i) {
+        auto [senderEnd, receiverEnd] = makeLoopbackPair(link);
+        senderLinks.push_back(senderEnd.get());
+        receiverLinks.push_back(std::make_unique<CountingTransport>(*receiverEnd));
+        receiverLinkPointers.push_back(receiverLinks.back().get());
+        senderEnds.push_back(std::move(senderEnd));
+        receiverEnds.push_back(std::move(receiverEnd));
+    }
+    Transport& senderLink = *senderLinks.front();
+    Transport& receiverLink = *receiverLinks.front();
+    bool received = false;
+
+    size_t allocationsBefore = allocationCount.load();
+    auto start = std::chrono::steady_clock::now();
+    std::thread receiver([&] {
+        if (mode.links > 1) {
+            received = receiveStriped(receiverLinkPointers, outputPath.string(), options);
+        } else {
+            received = mode.zmodem ? receiveFileZmodem(receiverLink, outputPath.string())
+                                   : receiveFile(receiverLink, outputPath.string(), options);
+        }
+    });
+    bool sent;
+    if (mode.links > 1) {
+        sent = sendStriped(senderLinks, inputPath.string(), options);
+    } else {
+        sent = mode.zmodem ? sendFileZmodem(senderLink, inputPath.string())
+                           : sendFile(senderLink, inputPath.string(), options);
+    }
+    receiver.join();
+
+    TransferResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = allocationCount.load() - allocationsBefore;
+    result.reads = 0;
+    for (const auto& receiverEnd : receiverLinks) {
+        result.reads += receiverEnd->reads;
+    }
+
+    std::vector<uint8_t> output = readWholeFile(outputPath);
+    // ZMODEM i nagłówki fragmentów podają długość pliku, więc wtedy też nie ma dopełnienia
+    bool exact = mode.trimPadding || mode.zmodem || mode.links > 1;
+    result.correct = sent && received && outputMatches(input, output, exact);
+    return result;
+}
+
+// Odbiór z checkpointami zerwany w połowie pliku i wznowiony drugą sesją. Plik musi się zgadzać co do
+// bajtu, druga sesja nie może przesłać go od początku, a checkpoint ma po niej zniknąć.
+bool runResume(const LinkParameters& link, const std::vector<uint8_t>& input, const std::filesystem::path& inputPath,
+               const std::filesystem::path& outputPath, uint64_t& resumedBytes) {
+    TransferOptions options;
+    options.crc = true;
+    options.oneK = true;
+    options.resume = true;
+    options.trimPadding = true;
+
+    std::ofstream(inputPath, std::ios::binary).write(reinterpret_cast<const char*>(input.data()), input.size());
+    std::filesystem::path checkpointPath = outputPath;
+    checkpointPath += ".xmc";
+    std::filesystem::remove(outputPath);
+    std::filesystem::remove(checkpointPath);
+
+    auto transfer = [&](uint64_t cutAfter, uint64_t& received) {
+        auto [senderEnd, receiverEnd] = makeLoopbackPair(link);
+        std::atomic<bool> cut{false};
+        CutTransport senderLink(*senderEnd, cut);
+        CutTransport receiverLink(*receiverEnd, cut, cutAfter);
+        bool receivedFile = false;
+        std::thread receiver([&] {
+            receivedFile = receiveFile(receiverLink, outputPath.string(), options);
+        });
+        bool sent = sendFile(senderLink, inputPath.string(), options);
+        receiver.join();
+        received = receiverLink.received;
+        return sent && receivedFile;
+    };
+
+    uint64_t interruptedBytes = 0;
+    bool interrupted = !transfer(input.size() / 2, interruptedBytes) && std::filesystem::exists(checkpointPath);
+    bool resumed = transfer(UINT64_MAX, resumedBytes) && resumedBytes < input.size();
+    return interrupted && resumed && outputMatches(input, readWholeFile(outputPath), true)
+        && !std::filesystem::exists(checkpointPath);
+}
+
+// ZMODEM, gdy po przerwanej transmisji został początek pliku. Z poprawnym początkiem odbiornik wznawia
+// od jego końca, więc odbiera mniej niż cały plik; z przekłamanym musi zacząć od zera. W obu
+// przypadkach plik ma się zgadzać co do bajtu.
+bool runZmodemResume(const LinkParameters& link, const std::vector<uint8_t>& input,
+                     const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, bool damaged,
+                     uint64_t& receivedBytes) {
+    std::ofstream(inputPath, std::ios::binary).write(reinterpret_cast<const char*>(input.data()), input.size());
+    std::vector<uint8_t> partial(input.begin(), input.begin() + std::min<size_t>(BENCH_PARTIAL_SIZE, input.size() / 2));
+    if (damaged) {
+        partial.front() ^= 0xFF;
+    }
+    std::ofstream(outputPath, std::ios::binary).write(reinterpret_cast<const char*>(partial.data()), partial.size());
+
+    auto [senderEnd, receiverEnd] = makeLoopbackPair(link);
+    std::atomic<bool> cut{false};
+    CutTransport receiverLink(*receiverEnd, cut);
+    bool received = false;
+    std::thread receiver([&] {
+        received = receiveFileZmodem(receiverLink, outputPath.string());
+    });
+    bool sent = sendFileZmodem(*senderEnd, inputPath.string());
+    receiver.join();
+
+    receivedBytes = receiverLink.received;
+    bool resumed = damaged ? receivedBytes > input.size() : receivedBytes < input.size() - partial.size() / 2;
+    return sent && received && resumed && outputMatches(input, readWholeFile(outputPath), true);
+}
+
+// Sesja YMODEM z dwoma plikami: pierwszy ma nazwę tak długą, że blok 0 idzie jako STX, a po nim
+// krótszy opis w bloku SOH. Oba pliki muszą przyjść pod swoimi nazwami i z dokładną długością.
+bool runBatch(const LinkParameters& link, const std::vector<uint8_t>& input, const std::filesystem::path& directory) {
+    TransferOptions options;
+    options.crc = true;
+    options.oneK = true;
+
+    std::filesystem::path sourceDirectory = directory / "xmodem_bench_batch_in";
+    std::filesystem::path targetDirectory = directory / "xmodem_bench_batch_out";
+    std::filesystem::remove_all(sourceDirectory);
+    std::filesystem::remove_all(targetDirectory);
+    std::filesystem::create_directories(sourceDirectory);
+    std::filesystem::create_directories(targetDirectory);
+
+    std::vector<std::string> names = {std::string(150, 'n') + ".bin", "krotki.bin"};
+    std::vector<std::vector<uint8_t>> files = {input, std::vector<uint8_t>(input.begin(), input.begin() + 1000)};
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < names.size(); ++i) {
+        paths.push_back((sourceDirectory / names[i]).string());
+        std::ofstream(paths.back(), std::ios::binary)
+            .write(reinterpret_cast<const char*>(files[i].data()), files[i].size());
+    }
+
+    auto [senderEnd, receiverEnd] = makeLoopbackPair(link);
+    bool received = false;
+    std::thread receiver([&] {
+        received = receiveBatch(*receiverEnd, targetDirectory.string(), options);
+    });
+    bool sent = sendBatch(*senderEnd, paths, options);
+    receiver.join();
+
+    bool correct = sent && received;
+    for (size_t i = 0; i < names.size(); ++i) {
+        correct = correct && outputMatches(files[i], readWholeFile(targetDirectory / names[i]), true);
+    }
+    correct = correct && std::distance(std::filesystem::directory_iterator(targetDirectory),
+                                       std::filesystem::directory_iterator()) == static_cast<long>(names.size());
+
+    std::filesystem::remove_all(sourceDirectory);
+    std::filesystem::remove_all(targetDirectory);
+    return correct;
+}
+
+int main(int argc, char* argv[]) {
+    size_t sizeKiB = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+    LinkParameters link;
+    link.bytesPerSecond = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+    link.latency = std::chrono::microseconds(argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 2000);
+
+    auto directory = std::filesystem::temp_directory_path();
+    auto inputPath = directory / "xmodem_bench_in.bin";
+    auto outputPath = directory / "xmodem_bench_out.bin";
+
+    std::vector<uint8_t> input((std::max<size_t>(sizeKiB, 2) - 1) * 1024 + BENCH_TAIL_SIZE);
+    std::mt19937 generator(12345);
+    for (auto& byte : input) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    // obcinanie dopełnienia zabrałoby też prawdziwe 0x1A z końca pliku
+    if (input.back() == 0x1A) {
+        input.back() = 0;
+    }
+    // końcówka pliku z połową bloków - liczba alokacji nie może zależeć od liczby bloków
+    std::vector<uint8_t> half(input.end() - (std::max<size_t>(sizeKiB / 2, 1) - 1) * 1024 - BENCH_TAIL_SIZE,
+                              input.end());
+
+    std::cout << "Plik " << input.size() << " B, łącze " << link.bytesPerSecond << " B/s, opóźnienie "
+              << link.latency.count() << " us" << std::endl;
+
+    bool allPassed = true;
+    for (const auto& mode : modes) {
+        TransferResult result = runTransfer(mode, link, input, inputPath, outputPath);
+        TransferResult halfResult = runTransfer(mode, link, half, inputPath, outputPath);
+        // każdy fragment ma własny plik i wątki, więc przy kilku łączach porównujemy tylko pliki
+        // podzielone na tyle samo fragmentów
+        auto stripes = [&](size_t size) {
+            uint64_t stripeSize = stripeSizeFor(size, mode.links);
+            return mode.links > 1 ? (size + stripeSize - 1) / stripeSize : 1;
+        };
+        bool comparable = stripes(input.size()) == stripes(half.size());
+        bool constantAllocations = !comparable || result.allocations == halfResult.allocations;
+        allPassed = allPassed && result.correct && halfResult.correct && constantAllocations;
+
+        size_t blocks = input.size() / (mode.oneK ? BLOCK_SIZE_1K : BLOCK_SIZE);
+        std::cout << std::left << std::setw(16) << mode.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(9) << result.seconds << " s" << std::setw(12) << std::setprecision(1)
+                  << input.size() / result.seconds / 1024 << " KiB/s" << std::setw(8) << result.allocations
+                  << " alokacji (" << halfResult.allocations << " przy połowie pliku"
+                  << (comparable ? "" : ", inna liczba fragmentów") << "), " << std::setprecision(2)
+                  << static_cast<double>(result.reads) / blocks << " odczytów na blok"
+                  << (result.correct && halfResult.correct ? "" : "  BŁĄD")
+                  << (constantAllocations ? "" : "  ALOKACJE NA BLOK") << std::endl;
+    }
+
+    uint64_t resumedBytes = 0;
+    bool resumed = runResume(link, input, inputPath, outputPath, resumedBytes);
+    allPassed = allPassed && resumed;
+    std::cout << "wznowienie po zerwaniu: "
+              << (resumed ? "poprawnie, druga sesja odebrała " + std::to_string(resumedBytes) + " B" : "BŁĄD")
+              << std::endl;
+
+    for (bool damaged : {false, true}) {
+        uint64_t receivedBytes = 0;
+        bool correct = runZmodemResume(link, input, inputPath, outputPath, damaged, receivedBytes);
+        allPassed = allPassed && correct;
+        std::cout << "ZMODEM, " << (damaged ? "przekłamany" : "poprawny") << " początek pliku: "
+                  << (correct ? "poprawnie, odebrano " + std::to_string(receivedBytes) + " B" : "BŁĄD") << std::endl;
+    }
+
+    bool batch = runBatch(link, input, directory);
+    allPassed = allPassed && batch;
+    std::cout << "YMODEM, dwa pliki: " << (batch ? "poprawnie" : "BŁĄD") << std::endl;
+
+    for (const auto& mode : modes) {
+        if (mode.window > 0 || mode.streaming || mode.zmodem || mode.crc32 || mode.links > 1 || mode.trimPadding) {
+            continue;
+        }
+        TransferOptions options;
+        options.crc = mode.crc;
+        options.oneK = mode.oneK;
+        for (const auto& pairing : pairings) {
+            long corrupted = runMachines(options, pairing, input, 10007);
+            allPassed = allPassed && corrupted >= 0;
+            std::cout << std::left << std::setw(16) << mode.name << " " << std::setw(17) << pairing.name << std::right
+                      << " w pamięci: "
+                      << (corrupted >= 0 ? "poprawnie, " + std::to_string(corrupted) + " przekłamań" : "BŁĄD")
+                      << std::endl;
+        }
+    }
+
+    std::filesystem::remove(inputPath);
+    std::filesystem::remove(outputPath);
+    return allPassed ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+#include "crc.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(CRC_X86) && defined(__GNUC__)
+#define TARGET_PCLMUL __attribute__((target("pclmul,ssse3")))
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_PCLMUL
+#define TARGET_SSE42
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+// Wektor kontrolny "123456789" i wartości z katalogu RevEng - pomyłka w parametrach nie skompiluje się
+constexpr std::array<uint8_t, 9> checkInput = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+static_assert(CRC16Xmodem::compute(checkInput) == 0x31C3);
+static_assert(CRC16Ccitt::compute(checkInput) == 0x2189);
+static_assert(CRC32::compute(checkInput) == 0xCBF43926);
+static_assert(CRC32C::compute(checkInput) == 0xE3069283);
+
+uint8_t calculateChecksumBytewise(const uint8_t* data, size_t length) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; ++i) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+uint16_t calculateCRC16Bytewise(const uint8_t* data, size_t length) {
+    const auto& table = CRC16Xmodem::tables[0];
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; ++i) {
+        crc = (crc << 8) ^ table[((crc >> 8) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+static uint16_t updateCRC16SliceBy8(uint16_t crc, const uint8_t* data, size_t length) {
+    return CRC16Xmodem::update(crc, data, length);
+}
+
+uint16_t calculateCRC16SliceBy8(const uint8_t* data, size_t length) {
+    return updateCRC16SliceBy8(0, data, length);
+}
+
+#ifdef CRC_X86
+
+// x^n mod P(x) dla P = 0x11021, stałe do składania 128-bitowych bloków mnożeniem bez przeniesień
+constexpr uint64_t xPowModCRC16(unsigned n) {
+    uint32_t remainder = 1;
+    for (unsigned i = 0; i < n; ++i) {
+        remainder <<= 1;
+        if (remainder & 0x10000) {
+            remainder ^= 0x11021;
+        }
+    }
+    return remainder;
+}
+
+TARGET_PCLMUL static __m128i loadReversed(const uint8_t* data) {
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), reverse);
+}
+
+// Zastępuje x * x^distance wielomianem przystającym modulo P: górną połówkę mnożymy przez
+// x^(distance+64) mod P, dolną przez x^distance mod P. Wynik ma najwyżej 79 bitów.
+TARGET_PCLMUL static __m128i fold(__m128i x, __m128i constants) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, constants, 0x11), _mm_clmulepi64_si128(x, constants, 0x00));
+}
+
+template <unsigned distance>
+TARGET_PCLMUL static __m128i foldConstants() {
+    constexpr uint64_t high = xPowModCRC16(distance + 64);
+    constexpr uint64_t low = xPowModCRC16(distance);
+    return _mm_set_epi64x(static_cast<long long>(high), static_cast<long long>(low));
+}
+
+TARGET_PCLMUL uint16_t calculateCRC16Clmul(const uint8_t* data, size_t length) {
+    if (length < 64) {
+        return updateCRC16SliceBy8(0, data, length);
+    }
+
+    __m128i x0 = loadReversed(data);
+    __m128i x1 = loadReversed(data + 16);
+    __m128i x2 = loadReversed(data + 32);
+    __m128i x3 = loadReversed(data + 48);
+    data += 64;
+    length -= 64;
+
+    // cztery niezależne akumulatory, żeby ukryć opóźnienie pclmulqdq
+    const __m128i by512 = foldConstants<512>();
+    while (length >= 64) {
+        x0 = _mm_xor_si128(fold(x0, by512), loadReversed(data));
+        x1 = _mm_xor_si128(fold(x1, by512), loadReversed(data + 16));
+        x2 = _mm_xor_si128(fold(x2, by512), loadReversed(data + 32));
+        x3 = _mm_xor_si128(fold(x3, by512), loadReversed(data + 48));
+        data += 64;
+        length -= 64;
+    }
+
+    const __m128i by128 = foldConstants<128>();
+    __m128i x = _mm_xor_si128(_mm_xor_si128(fold(x0, foldConstants<384>()), fold(x1, foldConstants<256>())),
+                              _mm_xor_si128(fold(x2, by128), x3));
+    while (length >= 16) {
+        x = _mm_xor_si128(fold(x, by128), loadReversed(data));
+        data += 16;
+        length -= 16;
+    }
+
+    // x przystaje do całego dotychczasowego prefiksu, więc jego CRC liczone z tablic jest CRC prefiksu
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    alignas(16) uint8_t folded[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(folded), _mm_shuffle_epi8(x, reverse));
+    uint16_t crc = updateCRC16SliceBy8(0, folded, sizeof(folded));
+    return updateCRC16SliceBy8(crc, data, length);
+}
+
+// Instrukcja crc32 z SSE4.2 liczy właśnie CRC-32C, 8 bajtów na raz w trybie 64-bitowym
+TARGET_SSE42 uint32_t calculateCRC32CSse42(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    while (length >= 4) {
+        uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        data += 4;
+        length -= 4;
+    }
+    while (length-- > 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return ~crc;
+}
+
+// psadbw sumuje po 8 bajtów w 64-bitowych połówkach rejestru, więc akumulatory się nie przepełnią;
+// suma modulo 256 zależy tylko od najniższego bajtu wyniku
+TARGET_SSE2 uint8_t calculateChecksumSse2(const uint8_t* data, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum0 = zero;
+    __m128i sum1 = zero;
+
+    while (length >= 32) {
+        sum0 = _mm_add_epi64(sum0, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), zero));
+        sum1 = _mm_add_epi64(sum1, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), zero));
+        data += 32;
+        length -= 32;
+    }
+    __m128i sum = _mm_add_epi64(sum0, sum1);
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+
+    uint8_t checksum = static_cast<uint8_t>(_mm_cvtsi128_si32(sum));
+    while (length-- > 0) {
+        checksum += *data++;
+    }
+    return checksum;
+}
+
+TARGET_AVX2 uint8_t calculateChecksumAvx2(const uint8_t* data, size_t length) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum0 = zero;
+    __m256i sum1 = zero;
+    __m256i sum2 = zero;
+    __m256i sum3 = zero;
+
+    // blok XMODEM to dokładnie jeden obieg tej pętli
+    while (length >= 128) {
+        const __m256i* vectors = reinterpret_cast<const __m256i*>(data);
+        sum0 = _mm256_add_epi64(sum0, _mm256_sad_epu8(_mm256_loadu_si256(vectors), zero));
+        sum1 = _mm256_add_epi64(sum1, _mm256_sad_epu8(_mm256_loadu_si256(vectors + 1), zero));
+        sum2 = _mm256_add_epi64(sum2, _mm256_sad_epu8(_mm256_loadu_si256(vectors + 2), zero));
+        sum3 = _mm256_add_epi64(sum3, _mm256_sad_epu8(_mm256_loadu_si256(vectors + 3), zero));
+        data += 128;
+        length -= 128;
+    }
+    while (length >= 32) {
+        sum0 = _mm256_add_epi64(sum0, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)), zero));
+        data += 32;
+        length -= 32;
+    }
+    __m256i sum256 = _mm256_add_epi64(_mm256_add_epi64(sum0, sum1), _mm256_add_epi64(sum2, sum3));
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+
+    uint8_t checksum = static_cast<uint8_t>(_mm_cvtsi128_si32(sum));
+    while (length-- > 0) {
+        checksum += *data++;
+    }
+    return checksum;
+}
+
+// Rejestry eax, ebx, ecx, edx z CPUID dla funkcji leaf (podfunkcja 0); zera, gdy procesor jej nie ma
+static std::array<unsigned, 4> cpuid(unsigned leaf) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, leaf, 0);
+    return {static_cast<unsigned>(info[0]), static_cast<unsigned>(info[1]), static_cast<unsigned>(info[2]),
+            static_cast<unsigned>(info[3])};
+#else
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid_count(leaf, 0, &eax, &ebx, &ecx, &edx)) {
+        return {0, 0, 0, 0};
+    }
+    return {eax, ebx, ecx, edx};
+#endif
+}
+
+// Stan rejestrów, które system zapisuje przy przełączaniu wątków (XCR0)
+static uint64_t enabledStateComponents() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+static bool cpuSupportsClmul() {
+    // ECX bit 1 - PCLMULQDQ, bit 9 - SSSE3 (pshufb)
+    unsigned ecx = cpuid(1)[2];
+    return (ecx & (1u << 1)) && (ecx & (1u << 9));
+}
+
+static bool cpuSupportsSse42() {
+    return cpuid(1)[2] & (1u << 20);
+}
+
+static bool cpuSupportsSse2() {
+    return cpuid(1)[3] & (1u << 26);
+}
+
+static bool cpuSupportsAvx2() {
+    // AVX2 (leaf 7, EBX bit 5) wolno używać tylko wtedy, gdy system zapisuje rejestry ymm:
+    // ECX bit 27 - OSXSAVE, bit 28 - AVX, a w XCR0 ustawione bity stanu SSE i AVX
+    unsigned ecx = cpuid(1)[2];
+    if (!(ecx & (1u << 27)) || !(ecx & (1u << 28)) || (enabledStateComponents() & 6) != 6) {
+        return false;
+    }
+    return cpuid(7)[1] & (1u << 5);
+}
+
+#else
+
+uint16_t calculateCRC16Clmul(const uint8_t* data, size_t length) {
+    return updateCRC16SliceBy8(0, data, length);
+}
+
+uint32_t calculateCRC32CSse42(const uint8_t* data, size_t length) {
+    return CRC32C::compute(data, length);
+}
+
+uint8_t calculateChecksumSse2(const uint8_t* data, size_t length) {
+    return calculateChecksumBytewise(data, length);
+}
+
+uint8_t calculateChecksumAvx2(const uint8_t* data, size_t length) {
+    return calculateChecksumBytewise(data, length);
+}
+
+static bool cpuSupportsClmul() {
+    return false;
+}
+
+static bool cpuSupportsSse42() {
+    return false;
+}
+
+static bool cpuSupportsSse2() {
+    return false;
+}
+
+static bool cpuSupportsAvx2() {
+    return false;
+}
+
+#endif
+
+bool checksumSse2Supported() {
+    static const bool supported = cpuSupportsSse2();
+    return supported;
+}
+
+bool checksumAvx2Supported() {
+    static const bool supported = cpuSupportsAvx2();
+    return supported;
+}
+
+using ChecksumKernel = uint8_t (*)(const uint8_t*, size_t);
+
+// Jądro wybieramy przy pierwszym wywołaniu, a nie przy inicjalizacji statycznej - wywołanie
+// z inicjalizatora w innej jednostce kompilacji nie trafi na jeszcze pusty wskaźnik
+uint8_t calculateChecksum(const uint8_t* data, size_t length) {
+    static const ChecksumKernel kernel = checksumAvx2Supported() ? calculateChecksumAvx2
+        : checksumSse2Supported() ? calculateChecksumSse2 : calculateChecksumBytewise;
+    return kernel(data, length);
+}
+
+uint8_t calculateChecksum(std::span<const uint8_t> data) {
+    return calculateChecksum(data.data(), data.size());
+}
+
+bool crc16ClmulSupported() {
+    static const bool supported = cpuSupportsClmul();
+    return supported;
+}
+
+using Crc16Kernel = uint16_t (*)(const uint8_t*, size_t);
+
+uint16_t calculateCRC16(const uint8_t* data, size_t length) {
+    static const Crc16Kernel kernel = crc16ClmulSupported() ? calculateCRC16Clmul : calculateCRC16SliceBy8;
+    return kernel(data, length);
+}
+
+uint16_t calculateCRC16(std::span<const uint8_t> data) {
+    return calculateCRC16(data.data(), data.size());
+}
+
+uint32_t updateCRC32(uint32_t crc, const uint8_t* data, size_t length) {
+    return CRC32::update(crc, data, length);
+}
+
+uint32_t calculateCRC32(const uint8_t* data, size_t length) {
+    return updateCRC32(0, data, length);
+}
+
+uint32_t calculateCRC32(std::span<const uint8_t> data) {
+    return calculateCRC32(data.data(), data.size());
+}
+
+uint32_t calculateCRC32CSliceBy8(const uint8_t* data, size_t length) {
+    return CRC32C::compute(data, length);
+}
+
+bool crc32cSse42Supported() {
+    static const bool supported = cpuSupportsSse42();
+    return supported;
+}
+
+using Crc32Kernel = uint32_t (*)(const uint8_t*, size_t);
+
+uint32_t calculateCRC32C(const uint8_t* data, size_t length) {
+    static const Crc32Kernel kernel = crc32cSse42Supported() ? calculateCRC32CSse42 : calculateCRC32CSliceBy8;
+    return kernel(data, length);
+}
+
+uint32_t calculateCRC32C(std::span<const uint8_t> data) {
+    return calculateCRC32C(data.data(), data.size());
+}
@@ -0,0 +1,146 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+// Tablice slice-by-8 dla CRC o szerokości Width bitów: tables[k][b] to CRC bajtu b, po którym
+// następuje k bajtów zerowych. Liczy je kompilator, więc nowy wariant CRC nie kosztuje nic przy starcie.
+template <typename Value, unsigned Width, uint64_t Polynomial, bool Reflected>
+constexpr std::array<std::array<Value, 256>, 8> makeCRCTables() {
+    constexpr Value mask = static_cast<Value>(Width == 64 ? ~0ull : (1ull << Width) - 1);
+    Value polynomial = static_cast<Value>(Polynomial & mask);
+    if constexpr (Reflected) {
+        Value reflected = 0;
+        for (unsigned i = 0; i < Width; ++i) {
+            if ((polynomial >> i) & 1) {
+                reflected |= static_cast<Value>(Value(1) << (Width - 1 - i));
+            }
+        }
+        polynomial = reflected;
+    }
+
+    std::array<std::array<Value, 256>, 8> tables{};
+    for (unsigned b = 0; b < 256; ++b) {
+        Value crc = Reflected ? static_cast<Value>(b) : static_cast<Value>(Value(b) << (Width - 8));
+        for (int bit = 0; bit < 8; ++bit) {
+            if constexpr (Reflected) {
+                crc = static_cast<Value>((crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1);
+            } else {
+                bool top = (crc >> (Width - 1)) & 1;
+                crc = static_cast<Value>(((crc << 1) ^ (top ? polynomial : 0)) & mask);
+            }
+        }
+        tables[0][b] = crc;
+    }
+    for (int k = 1; k < 8; ++k) {
+        for (unsigned b = 0; b < 256; ++b) {
+            Value previous = tables[k - 1][b];
+            if constexpr (Reflected) {
+                tables[k][b] = static_cast<Value>((previous >> 8) ^ tables[0][previous & 0xFF]);
+            } else {
+                tables[k][b] = static_cast<Value>(((previous << 8) & mask) ^ tables[0][(previous >> (Width - 8)) & 0xFF]);
+            }
+        }
+    }
+    return tables;
+}
+
+// CRC opisane parametrami jak w katalogu RevEng: szerokość, wielomian, odbicie bitów, wartość
+// początkowa i końcowy XOR. update() przyjmuje i zwraca gotową wartość CRC, więc dane można
+// podawać w kawałkach.
+template <unsigned Width, uint64_t Polynomial, bool Reflected, uint64_t Initial, uint64_t FinalXor>
+struct CRCAlgorithm {
+    static_assert(Width >= 8 && Width <= 64 && Width % 8 == 0, "obsługiwane są szerokości 8, 16, ..., 64");
+
+    using Value = std::conditional_t<Width == 8, uint8_t,
+                  std::conditional_t<Width == 16, uint16_t, std::conditional_t<(Width <= 32), uint32_t, uint64_t>>>;
+    static constexpr Value mask = static_cast<Value>(Width == 64 ? ~0ull : (1ull << Width) - 1);
+    static constexpr auto tables = makeCRCTables<Value, Width, Polynomial, Reflected>();
+
+    static constexpr Value update(Value crc, const uint8_t* data, size_t length) {
+        crc = static_cast<Value>((crc ^ FinalXor) & mask);
+
+        // CRC wchodzi w pierwsze Width / 8 bajtów, a osiem odczytów tablic nie zależy od siebie
+        while (length >= 8) {
+            uint8_t bytes[8];
+            for (unsigned i = 0; i < 8; ++i) {
+                bytes[i] = data[i];
+            }
+            for (unsigned i = 0; i < Width / 8; ++i) {
+                bytes[i] ^= static_cast<uint8_t>(Reflected ? crc >> (8 * i) : crc >> (Width - 8 - 8 * i));
+            }
+            Value next = 0;
+            for (unsigned i = 0; i < 8; ++i) {
+                next ^= tables[7 - i][bytes[i]];
+            }
+            crc = next;
+            data += 8;
+            length -= 8;
+        }
+        while (length-- > 0) {
+            if constexpr (Reflected) {
+                crc = static_cast<Value>((crc >> 8) ^ tables[0][(crc ^ *data++) & 0xFF]);
+            } else {
+                crc = static_cast<Value>(((crc << 8) & mask) ^ tables[0][((crc >> (Width - 8)) ^ *data++) & 0xFF]);
+            }
+        }
+        return static_cast<Value>((crc ^ FinalXor) & mask);
+    }
+
+    static constexpr Value compute(const uint8_t* data, size_t length) {
+        return update(static_cast<Value>((Initial ^ FinalXor) & mask), data, length);
+    }
+
+    static constexpr Value compute(std::span<const uint8_t> data) {
+        return compute(data.data(), data.size());
+    }
+};
+
+using CRC16Xmodem = CRCAlgorithm<16, 0x1021, false, 0x0000, 0x0000>;
+// "CCITT" bywa nazwą kilku wariantów; tu tak jak w katalogu RevEng, czyli CRC-16/KERMIT
+using CRC16Ccitt = CRCAlgorithm<16, 0x1021, true, 0x0000, 0x0000>;
+using CRC32 = CRCAlgorithm<32, 0x04C11DB7, true, 0xFFFFFFFF, 0xFFFFFFFF>;
+using CRC32C = CRCAlgorithm<32, 0x1EDC6F41, true, 0xFFFFFFFF, 0xFFFFFFFF>;
+
+uint8_t calculateChecksum(const uint8_t* data, size_t length);
+uint8_t calculateChecksum(std::span<const uint8_t> data);
+
+// Wersje sumy kontrolnej do porównań; wektorowe sumują bajty instrukcją psadbw
+uint8_t calculateChecksumBytewise(const uint8_t* data, size_t length);
+// wolno wołać tylko gdy checksumSse2Supported() / checksumAvx2Supported()
+uint8_t calculateChecksumSse2(const uint8_t* data, size_t length);
+uint8_t calculateChecksumAvx2(const uint8_t* data, size_t length);
+bool checksumSse2Supported();
+bool checksumAvx2Supported();
+
+// CRC-16/XMODEM (wielomian 0x1021, wartość początkowa 0)
+uint16_t calculateCRC16(const uint8_t* data, size_t length);
+uint16_t calculateCRC16(std::span<const uint8_t> data);
+
+// Poszczególne implementacje, wystawione dla porównań i benchmarków
+uint16_t calculateCRC16Bytewise(const uint8_t* data, size_t length);
+uint16_t calculateCRC16SliceBy8(const uint8_t* data, size_t length);
+// Składanie mnożeniem bez przeniesień (PCLMULQDQ); wolno wołać tylko gdy crc16ClmulSupported()
+uint16_t calculateCRC16Clmul(const uint8_t* data, size_t length);
+bool crc16ClmulSupported();
+
+// CRC-32 (odbity wielomian 0xEDB88320, jak w ZMODEM i zlib)
+uint32_t calculateCRC32(const uint8_t* data, size_t length);
+uint32_t calculateCRC32(std::span<const uint8_t> data);
+// Dokłada kolejne dane do CRC-32 policzonego dla wcześniejszej części
+uint32_t updateCRC32(uint32_t crc, const uint8_t* data, size_t length);
+
+// CRC-32C (Castagnoli, odbity wielomian 0x82F63B78), końcówka ramek w trybie 32-bitowym
+uint32_t calculateCRC32C(const uint8_t* data, size_t length);
+uint32_t calculateCRC32C(std::span<const uint8_t> data);
+
+uint32_t calculateCRC32CSliceBy8(const uint8_t* data, size_t length);
+// Instrukcja crc32 z SSE4.2; wolno wołać tylko gdy crc32cSse42Supported()
+uint32_t calculateCRC32CSse42(const uint8_t* data, size_t length);
+bool crc32cSse42Supported();
+
+#endif
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "crc.h"
+
+template <typename Value>
+struct Kernel {
+    const char* name;
+    Value (*function)(const uint8_t*, size_t);
+};
+
+// Pierwsza implementacja na liście jest wzorcem dla pozostałych
+std::vector<Kernel<uint8_t>> availableChecksumKernels() {
+    std::vector<Kernel<uint8_t>> kernels = {
+        {"bajt po bajcie", calculateChecksumBytewise},
+    };
+    if (checksumSse2Supported()) {
+        kernels.push_back({"sse2 psadbw", calculateChecksumSse2});
+    }
+    if (checksumAvx2Supported()) {
+        kernels.push_back({"avx2 vpsadbw", calculateChecksumAvx2});
+    }
+    return kernels;
+}
+
+std::vector<Kernel<uint16_t>> availableCRC16Kernels() {
+    std::vector<Kernel<uint16_t>> kernels = {
+        {"bajt po bajcie", calculateCRC16Bytewise},
+        {"slice-by-8", calculateCRC16SliceBy8},
+    };
+    if (crc16ClmulSupported()) {
+        kernels.push_back({"pclmulqdq", calculateCRC16Clmul});
+    }
+    return kernels;
+}
+
+std::vector<Kernel<uint32_t>> availableCRC32CKernels() {
+    std::vector<Kernel<uint32_t>> kernels = {
+        {"slice-by-8", calculateCRC32CSliceBy8},
+    };
+    if (crc32cSse42Supported()) {
+        kernels.push_back({"sse4.2 crc32", calculateCRC32CSse42});
+    }
+    return kernels;
+}
+
+template <typename Value>
+bool verify(const std::vector<Kernel<Value>>& kernels, const std::vector<uint8_t>& data) {
+    bool ok = true;
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t length = 0; length + offset <= data.size(); length += length < 64 ? 1 : 61) {
+            Value expected = kernels[0].function(data.data() + offset, length);
+            for (const auto& kernel : kernels) {
+                if (kernel.function(data.data() + offset, length) != expected) {
+                    std::cout << "Niezgodność: " << kernel.name << ", przesunięcie " << offset
+                              << ", długość " << length << std::endl;
+                    ok = false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+template <typename Value>
+double measure(Value (*function)(const uint8_t*, size_t), const std::vector<uint8_t>& data, size_t blockSize,
+               int rounds) {
+    volatile Value sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        for (size_t offset = 0; offset + blockSize <= data.size(); offset += blockSize) {
+            sink = sink ^ function(data.data() + offset, blockSize);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(data.size() / blockSize * blockSize) * rounds / seconds / 1e6;
+}
+
+template <typename Value>
+void report(const char* title, const std::vector<Kernel<Value>>& kernels, const std::vector<uint8_t>& data,
+            int rounds) {
+    for (size_t blockSize : {128, 1024}) {
+        std::cout << title << ", bloki " << blockSize << " B:" << std::endl;
+        for (const auto& kernel : kernels) {
+            std::cout << "  " << std::left << std::setw(16) << kernel.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(10) << measure(kernel.function, data, blockSize, rounds)
+                      << " MB/s" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+
+    std::vector<uint8_t> data(1 << 20);
+    std::mt19937 generator(12345);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(generator());
+    }
+
+    // "123456789" to standardowy wektor kontrolny, CRC-16/XMODEM daje dla niego 0x31C3
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    bool ok = calculateCRC16(check, sizeof(check)) == 0x31C3;
+    // CRC-32 (ZMODEM) daje 0xCBF43926, także liczone w dwóch częściach
+    ok = ok && calculateCRC32(check, sizeof(check)) == 0xCBF43926
+        && updateCRC32(calculateCRC32(check, 4), check + 4, sizeof(check) - 4) == 0xCBF43926;
+    ok = ok && calculateCRC32C(check, sizeof(check)) == 0xE3069283;
+
+    auto checksumKernels = availableChecksumKernels();
+    auto crc16Kernels = availableCRC16Kernels();
+    auto crc32cKernels = availableCRC32CKernels();
+    std::vector<uint8_t> sample(data.begin(), data.begin() + 4096);
+    ok = verify(checksumKernels, sample) && verify(crc16Kernels, sample) && verify(crc32cKernels, sample) && ok;
+    std::cout << (ok ? "Wszystkie implementacje zgodne" : "Implementacje NIEZGODNE") << std::endl;
+
+    report("Suma kontrolna", checksumKernels, data, rounds);
+    report("CRC-16", crc16Kernels, data, rounds);
+    report("CRC-32C", crc32cKernels, data, rounds);
+    return ok ? 0 : 1;
+}
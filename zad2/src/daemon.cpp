@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "event_loop.h"
+#include "serial.h"
+#include "xmodem_coroutine.h"
+#include "xmodem_machine.h"
+
+static void report(const std::string& message) {
+    // jedna operacja na strumieniu, żeby komunikaty z kilku pętli się nie przeplatały
+    std::cout << message + "\n" << std::flush;
+}
+
+// Maszyny XMODEM z plikiem po drugiej stronie i komunikatem na koniec transmisji
+template <typename Policy>
+class FileReceiver : public XmodemReceiver<Policy> {
+public:
+    FileReceiver(std::string port, std::string path)
+        : XmodemReceiver<Policy>([this](std::span<const uint8_t> block) {
+              return static_cast<bool>(file.write(reinterpret_cast<const char*>(block.data()), block.size()));
+          }),
+          port(std::move(port)), path(std::move(path)) {
+    }
+
+    void start(ProtocolMachine::Clock::time_point now) override {
+        file.open(path, std::ios::binary);
+        if (!file) {
+            this->abort();
+            return;
+        }
+        XmodemReceiver<Policy>::start(now);
+    }
+
+protected:
+    void completed(bool result) override {
+        file.close();
+        report(std::string(result && !file.fail() ? "Odebrano " : "Nie odebrano ") + path + " z " + port);
+    }
+
+private:
+    std::string port;
+    std::string path;
+    std::ofstream file;
+};
+
+class FileSender : public NegotiatingXmodemSender {
+public:
+    FileSender(std::string port, std::string path, const TransferOptions& options)
+        : NegotiatingXmodemSender(options, [this](std::span<uint8_t> buffer) {
+              file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+              return static_cast<size_t>(file.gcount());
+          }),
+          port(std::move(port)), path(std::move(path)) {
+    }
+
+    void start(Clock::time_point now) override {
+        file.open(path, std::ios::binary);
+        if (!file) {
+            abort();
+            return;
+        }
+        NegotiatingXmodemSender::start(now);
+    }
+
+protected:
+    void completed(bool result) override {
+        report(std::string(result ? "Wysłano " : "Nie wysłano ") + path + " przez " + port);
+    }
+
+private:
+    std::string port;
+    std::string path;
+    std::ifstream file;
+};
+
+// Te same transmisje jako korutyny: plik żyje w ramce korutyny, a komunikat pada po jej zakończeniu
+static Task<bool> receiveToFile(AsyncTransport& link, std::string port, std::string path, TransferOptions options) {
+    std::ofstream file(path, std::ios::binary);
+    bool result = file && co_await receiveXmodem(link, options, [&file](std::span<const uint8_t> block) {
+        return static_cast<bool>(file.write(reinterpret_cast<const char*>(block.data()), block.size()));
+    });
+    file.close();
+    result = result && !file.fail();
+    report(std::string(result ? "Odebrano " : "Nie odebrano ") + path + " z " + port);
+    co_return result;
+}
+
+static Task<bool> sendFromFile(AsyncTransport& link, std::string port, std::string path, TransferOptions options) {
+    std::ifstream file(path, std::ios::binary);
+    bool result = file && co_await sendXmodem(link, options, [&file](std::span<uint8_t> buffer) {
+        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+        return static_cast<size_t>(file.gcount());
+    });
+    report(std::string(result ? "Wysłano " : "Nie wysłano ") + path + " przez " + port);
+    co_return result;
+}
+
+// Wiersz konfiguracji: "R port plik [0|1|1k] [-b prędkość]" albo to samo z S; # zaczyna komentarz
+static bool addTransfer(EventLoop& loop, const std::string& line, bool coroutines) {
+    std::istringstream fields(line);
+    std::string direction;
+    std::string port;
+    std::string path;
+    if (!(fields >> direction >> port >> path) || (direction != "R" && direction != "S")) {
+        return false;
+    }
+
+    TransferOptions options;
+    unsigned baudRate = DEFAULT_BAUD_RATE;
+    std::string option;
+    while (fields >> option) {
+        if (option == "0") {
+            options.crc = false;
+        } else if (option == "1") {
+            options.crc = true;
+        } else if (option == "1k") {
+            options.crc = true;
+            options.oneK = true;
+        } else if (option == "-b" && fields >> baudRate) {
+        } else {
+            return false;
+        }
+    }
+
+    std::unique_ptr<ProtocolMachine> machine;
+    if (coroutines) {
+        auto session = direction == "S" ? sendFromFile : receiveToFile;
+        machine = std::make_unique<AsyncTransport>([=](AsyncTransport& link) {
+            return session(link, port, path, options);
+        });
+    } else if (direction == "S") {
+        machine = std::make_unique<FileSender>(port, path, options);
+    } else if (options.crc) {
+        machine = std::make_unique<FileReceiver<CRC16Policy>>(port, path);
+    } else {
+        machine = std::make_unique<FileReceiver<ChecksumPolicy>>(port, path);
+    }
+    if (!loop.addPort(port, baudRate, std::move(machine))) {
+        std::cerr << "Nie można otworzyć portu " << port << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Daemon konfiguracja [-j wątki] [-c]: wszystkie transmisje z pliku konfiguracji naraz, porty rozdzielone
+// po równo między wątki, z których każdy obsługuje swoje porty w jednej pętli zdarzeń. Z -c sesje
+// są korutynami zamiast maszyn stanów.
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        return -1;
+    }
+    unsigned threads = 1;
+    bool coroutines = false;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::max(atoi(argv[++i]), 1));
+        } else if (strcmp(argv[i], "-c") == 0) {
+            coroutines = true;
+        } else {
+            return -1;
+        }
+    }
+
+    std::ifstream config(argv[1]);
+    if (!config) {
+        std::cerr << "Nie można otworzyć " << argv[1] << std::endl;
+        return -1;
+    }
+
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    for (unsigned i = 0; i < threads; ++i) {
+        loops.push_back(std::make_unique<EventLoop>());
+    }
+    std::string line;
+    size_t transfers = 0;
+    while (std::getline(config, line)) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        if (!addTransfer(*loops[transfers % loops.size()], line, coroutines)) {
+            std::cerr << "Błędny wiersz konfiguracji: " << line << std::endl;
+            return -1;
+        }
+        transfers++;
+    }
+
+    std::vector<char> results(loops.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < loops.size(); ++i) {
+        workers.emplace_back([&, i] {
+            results[i] = loops[i]->run();
+        });
+    }
+    results[0] = loops[0]->run();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    bool success = std::all_of(results.begin(), results.end(), [](char result) {
+        return result != 0;
+    });
+    std::cout << (success ? "Wszystkie transmisje zakończone poprawnie" : "Nie wszystkie transmisje się udały")
+              << std::endl;
+    return success ? 0 : 1;
+}
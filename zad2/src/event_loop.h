@@ -0,0 +1,32 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "protocol_machine.h"
+
+// Jedna pętla zdarzeń dla wielu portów szeregowych w jednym wątku: epoll w Linuksie, port
+// zakończenia (IOCP) w Windows. Każdy port napędza swoją maszynę protokołu i jest zamykany, gdy
+// maszyna skończy pracę, a port przyjmie wszystko, co miała do wysłania.
+class EventLoop {
+public:
+    EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+    ~EventLoop();
+
+    bool addPort(const std::string& port, unsigned baudRate, std::unique_ptr<ProtocolMachine> machine);
+    // Obsługuje porty, dopóki wszystkie maszyny nie skończą pracy; true, gdy wszystkie się udały
+    bool run();
+
+private:
+    struct Port;
+
+    intptr_t handle;
+    std::vector<std::unique_ptr<Port>> ports;
+};
+
+#endif
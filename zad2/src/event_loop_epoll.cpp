@@ -0,0 +1,187 @@
+#include "event_loop.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "serial.h"
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 4096
+
+struct EventLoop::Port {
+    int fd;
+    std::unique_ptr<ProtocolMachine> machine;
+    // bajty, których port nie przyjął od razu; wysyłamy je po EPOLLOUT
+    std::vector<uint8_t> unsent;
+    uint32_t watched = EPOLLIN;
+    bool open = true;
+};
+
+EventLoop::EventLoop() : handle(epoll_create1(EPOLL_CLOEXEC)) {
+}
+
+EventLoop::~EventLoop() {
+    for (auto& port : ports) {
+        if (port->open) {
+            closeSerialPort(port->fd);
+        }
+    }
+    if (handle >= 0) {
+        close(static_cast<int>(handle));
+    }
+}
+
+bool EventLoop::addPort(const std::string& port, unsigned baudRate, std::unique_ptr<ProtocolMachine> machine) {
+    intptr_t fd = openSerialPort(port, baudRate, true);
+    if (handle < 0 || fd < 0) {
+        return false;
+    }
+
+    auto entry = std::make_unique<Port>();
+    entry->fd = static_cast<int>(fd);
+    entry->machine = std::move(machine);
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = entry.get();
+    if (epoll_ctl(static_cast<int>(handle), EPOLL_CTL_ADD, entry->fd, &event) != 0) {
+        closeSerialPort(fd);
+        return false;
+    }
+    ports.push_back(std::move(entry));
+    return true;
+}
+
+bool EventLoop::run() {
+    int epoll = static_cast<int>(handle);
+    size_t active = ports.size();
+
+    // Wysyła, co port przyjmie bez czekania; resztę zostawia na EPOLLOUT. False przy błędzie portu.
+    auto sendPending = [](Port& port) {
+        std::vector<uint8_t>& output = port.machine->output();
+        port.unsent.insert(port.unsent.end(), output.begin(), output.end());
+        output.clear();
+
+        size_t offset = 0;
+        while (offset < port.unsent.size()) {
+            ssize_t result = ::write(port.fd, port.unsent.data() + offset, port.unsent.size() - offset);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    break;
+                }
+                return false;
+            }
+            offset += result;
+        }
+        port.unsent.erase(port.unsent.begin(), port.unsent.begin() + offset);
+        return true;
+    };
+
+    // Po każdym wywołaniu maszyny wysyłamy jej bajty, a port zamykamy, gdy skończy pracę i port je przyjmie.
+    // Skończona maszyna nie czyta już z portu, więc czekamy tylko na miejsce na wysłanie reszty.
+    auto service = [&](Port& port) {
+        if (!port.open) {
+            return;
+        }
+        if (!sendPending(port)) {
+            port.machine->abort();
+            port.unsent.clear();
+        }
+        if (port.machine->finished() && port.unsent.empty()) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, port.fd, nullptr);
+            closeSerialPort(port.fd);
+            port.open = false;
+            active--;
+            return;
+        }
+
+        uint32_t watched = 0;
+        if (!port.machine->finished()) {
+            watched |= EPOLLIN;
+        }
+        if (!port.unsent.empty()) {
+            watched |= EPOLLOUT;
+        }
+        if (watched != port.watched) {
+            epoll_event event{};
+            event.events = watched;
+            event.data.ptr = &port;
+            epoll_ctl(epoll, EPOLL_CTL_MOD, port.fd, &event);
+            port.watched = watched;
+        }
+    };
+
+    auto now = ProtocolMachine::Clock::now();
+    for (auto& port : ports) {
+        port->machine->start(now);
+        service(*port);
+    }
+
+    std::array<epoll_event, MAX_EVENTS> events;
+    std::array<uint8_t, READ_CHUNK> buffer;
+    while (active > 0) {
+        auto deadline = ProtocolMachine::Clock::time_point::max();
+        for (auto& port : ports) {
+            if (port->open) {
+                deadline = std::min(deadline, port->machine->deadline());
+            }
+        }
+
+        int timeout = -1;
+        if (deadline != ProtocolMachine::Clock::time_point::max()) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - ProtocolMachine::Clock::now());
+            timeout = static_cast<int>(std::clamp<long long>(remaining.count(), 0, INT32_MAX));
+        }
+
+        int count = epoll_wait(epoll, events.data(), static_cast<int>(events.size()), timeout);
+        if (count < 0 && errno != EINTR) {
+            return false;
+        }
+        now = ProtocolMachine::Clock::now();
+
+        for (int i = 0; i < count; ++i) {
+            Port& port = *static_cast<Port*>(events[i].data.ptr);
+            if (!port.open) {
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                while (!port.machine->finished()) {
+                    ssize_t result = ::read(port.fd, buffer.data(), buffer.size());
+                    if (result > 0) {
+                        port.machine->feed(std::span(buffer.data(), static_cast<size_t>(result)), now);
+                        continue;
+                    }
+                    if (result < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    // przy VMIN = 0 pusty port zwraca 0 zamiast EAGAIN; rozłączenie zgłasza EPOLLHUP albo błąd
+                    if ((result == 0 && !(events[i].events & EPOLLHUP)) || (result < 0 && errno == EAGAIN)) {
+                        break;
+                    }
+                    port.machine->abort();
+                    port.unsent.clear();
+                    break;
+                }
+            }
+            service(port);
+        }
+
+        for (auto& port : ports) {
+            if (port->open && port->machine->deadline() <= now) {
+                port->machine->poll(now);
+                service(*port);
+            }
+        }
+    }
+
+    return std::all_of(ports.begin(), ports.end(), [](const auto& port) {
+        return port->machine->succeeded();
+    });
+}
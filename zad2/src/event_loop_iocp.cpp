@@ -0,0 +1,191 @@
+#include "event_loop.h"
+
+#include <algorithm>
+#include <array>
+#include <windows.h>
+
+#include "serial.h"
+
+#define MAX_EVENTS 64
+#define READ_CHUNK 4096
+
+// Każdy port ma stale zlecony jeden odczyt overlapped i najwyżej jeden zapis; ich zakończenia
+// przychodzą przez wspólny port zakończenia z kluczem wskazującym na Port.
+struct EventLoop::Port {
+    HANDLE handle;
+    std::unique_ptr<ProtocolMachine> machine;
+    OVERLAPPED readOverlapped;
+    std::array<uint8_t, READ_CHUNK> readBuffer;
+    bool reading = false;
+    OVERLAPPED writeOverlapped;
+    // writing jest w trakcie wysyłania, queued czeka na jego zakończenie
+    std::vector<uint8_t> writing;
+    std::vector<uint8_t> queued;
+    bool open = true;
+    bool closing = false;
+};
+
+static HANDLE toHandle(intptr_t handle) {
+    return reinterpret_cast<HANDLE>(handle);
+}
+
+EventLoop::EventLoop() : handle(reinterpret_cast<intptr_t>(CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1))) {
+}
+
+EventLoop::~EventLoop() {
+    for (auto& port : ports) {
+        if (port->open) {
+            CancelIoEx(port->handle, NULL);
+            CloseHandle(port->handle);
+        }
+    }
+    if (toHandle(handle) != NULL) {
+        CloseHandle(toHandle(handle));
+    }
+}
+
+bool EventLoop::addPort(const std::string& port, unsigned baudRate, std::unique_ptr<ProtocolMachine> machine) {
+    intptr_t serial = openSerialPort(port, baudRate, true);
+    if (toHandle(handle) == NULL || toHandle(serial) == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    auto entry = std::make_unique<Port>();
+    entry->handle = toHandle(serial);
+    entry->machine = std::move(machine);
+    if (CreateIoCompletionPort(entry->handle, toHandle(handle), reinterpret_cast<ULONG_PTR>(entry.get()), 0) == NULL) {
+        closeSerialPort(serial);
+        return false;
+    }
+    ports.push_back(std::move(entry));
+    return true;
+}
+
+bool EventLoop::run() {
+    HANDLE completionPort = toHandle(handle);
+    size_t active = ports.size();
+
+    // Zakończenie zlecenia trafia do portu zakończenia także wtedy, gdy ReadFile/WriteFile skończy się od razu
+    auto startRead = [](Port& port) {
+        port.readOverlapped = {};
+        if (!ReadFile(port.handle, port.readBuffer.data(), static_cast<DWORD>(port.readBuffer.size()), NULL,
+                      &port.readOverlapped) && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+        port.reading = true;
+        return true;
+    };
+
+    auto startWrite = [](Port& port) {
+        if (!port.writing.empty() || port.queued.empty()) {
+            return true;
+        }
+        port.writing.swap(port.queued);
+        port.writeOverlapped = {};
+        if (!WriteFile(port.handle, port.writing.data(), static_cast<DWORD>(port.writing.size()), NULL,
+                       &port.writeOverlapped) && GetLastError() != ERROR_IO_PENDING) {
+            port.writing.clear();
+            return false;
+        }
+        return true;
+    };
+
+    // Port zamykamy dopiero wtedy, gdy nie ma na nim żadnego zlecenia - bufory należą do niego do końca.
+    // Zlecony odczyt przerywa CancelIoEx, a jego zakończenie z błędem wraca tu jeszcze raz.
+    auto service = [&](Port& port) {
+        if (!port.open) {
+            return;
+        }
+        std::vector<uint8_t>& output = port.machine->output();
+        port.queued.insert(port.queued.end(), output.begin(), output.end());
+        output.clear();
+        if (!startWrite(port)) {
+            port.machine->abort();
+            port.queued.clear();
+        }
+
+        if (port.machine->finished() && port.writing.empty()) {
+            if (port.reading && !port.closing) {
+                CancelIoEx(port.handle, &port.readOverlapped);
+                port.closing = true;
+            }
+            if (!port.reading) {
+                CloseHandle(port.handle);
+                port.open = false;
+                active--;
+            }
+        }
+    };
+
+    auto now = ProtocolMachine::Clock::now();
+    for (auto& port : ports) {
+        port->machine->start(now);
+        if (!port->machine->finished() && !startRead(*port)) {
+            port->machine->abort();
+        }
+        service(*port);
+    }
+
+    std::array<OVERLAPPED_ENTRY, MAX_EVENTS> events;
+    while (active > 0) {
+        auto deadline = ProtocolMachine::Clock::time_point::max();
+        for (auto& port : ports) {
+            if (port->open) {
+                deadline = std::min(deadline, port->machine->deadline());
+            }
+        }
+
+        DWORD timeout = INFINITE;
+        if (deadline != ProtocolMachine::Clock::time_point::max()) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - ProtocolMachine::Clock::now());
+            timeout = static_cast<DWORD>(std::clamp<long long>(remaining.count(), 0, INFINITE - 1));
+        }
+
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(completionPort, events.data(), static_cast<ULONG>(events.size()), &count,
+                                         timeout, FALSE)) {
+            if (GetLastError() != WAIT_TIMEOUT) {
+                return false;
+            }
+            count = 0;
+        }
+        now = ProtocolMachine::Clock::now();
+
+        for (ULONG i = 0; i < count; ++i) {
+            Port& port = *reinterpret_cast<Port*>(events[i].lpCompletionKey);
+            // Internal to status NTSTATUS zakończonej operacji, 0 oznacza sukces
+            bool success = events[i].lpOverlapped->Internal == 0;
+            DWORD bytes = events[i].dwNumberOfBytesTransferred;
+
+            if (events[i].lpOverlapped == &port.readOverlapped) {
+                port.reading = false;
+                if (!port.machine->finished()) {
+                    if (success && bytes > 0) {
+                        port.machine->feed(std::span(port.readBuffer.data(), bytes), now);
+                    }
+                    if (!success || (!port.machine->finished() && !startRead(port))) {
+                        port.machine->abort();
+                    }
+                }
+            } else {
+                port.writing.clear();
+                if (!success) {
+                    port.machine->abort();
+                    port.queued.clear();
+                }
+            }
+            service(port);
+        }
+
+        for (auto& port : ports) {
+            if (port->open && port->machine->deadline() <= now) {
+                port->machine->poll(now);
+                service(*port);
+            }
+        }
+    }
+
+    return std::all_of(ports.begin(), ports.end(), [](const auto& port) {
+        return port->machine->succeeded();
+    });
+}
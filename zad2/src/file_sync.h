@@ -0,0 +1,9 @@
+#ifndef FILE_SYNC_H
+#define FILE_SYNC_H
+
+#include <string>
+
+// Zapisuje na dysk wszystko, co system trzyma jeszcze w pamięci podręcznej dla tego pliku
+bool syncFile(const std::string& path);
+
+#endif
@@ -0,0 +1,14 @@
+#include "file_sync.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+bool syncFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
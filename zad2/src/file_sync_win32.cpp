@@ -0,0 +1,15 @@
+#include "file_sync.h"
+
+#include <windows.h>
+
+bool syncFile(const std::string& path) {
+    // FlushFileBuffers wymaga uchwytu z prawem zapisu
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool synced = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return synced;
+}
@@ -0,0 +1,151 @@
+#include "loopback.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Bufor nadawczy sterownika portu: zapis czeka, aż na łączu zostanie najwyżej tyle bajtów do nadania
+#define TRANSMIT_BUFFER_SIZE 4096
+
+// Granica zapisu: dane do pozycji end (licząc od początku transmisji) są dostępne od deliveryTime.
+struct Chunk {
+    Transport::Clock::time_point deliveryTime;
+    uint64_t end;
+};
+
+// Bajty i granice zapisów trzymane są w wektorach, które po rozgrzaniu tylko zmieniają rozmiar
+// w ramach już przydzielonej pojemności, więc stały ruch przez łącze nie alokuje pamięci.
+struct LoopbackTransport::Channel {
+    LinkParameters parameters;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<uint8_t> bytes;
+    size_t firstByte = 0;
+    std::vector<Chunk> chunks;
+    size_t firstChunk = 0;
+    uint64_t written = 0;
+    uint64_t consumed = 0;
+    Clock::time_point busyUntil;
+};
+
+static void compact(LoopbackTransport::Channel& channel) {
+    if (channel.firstChunk == channel.chunks.size()) {
+        channel.chunks.clear();
+        channel.firstChunk = 0;
+    } else if (channel.firstChunk > channel.chunks.size() / 2) {
+        channel.chunks.erase(channel.chunks.begin(), channel.chunks.begin() + channel.firstChunk);
+        channel.firstChunk = 0;
+    }
+    if (channel.firstByte == channel.bytes.size()) {
+        channel.bytes.clear();
+        channel.firstByte = 0;
+    } else if (channel.firstByte > channel.bytes.size() / 2) {
+        channel.bytes.erase(channel.bytes.begin(), channel.bytes.begin() + channel.firstByte);
+        channel.firstByte = 0;
+    }
+}
+
+LoopbackTransport::LoopbackTransport(std::shared_ptr<Channel> incoming, std::shared_ptr<Channel> outgoing)
+    : incoming(std::move(incoming)), outgoing(std::move(outgoing)) {
+}
+
+int LoopbackTransport::read(uint8_t* data, size_t count, Clock::time_point deadline) {
+    Channel& channel = *incoming;
+    std::unique_lock lock(channel.mutex);
+
+    while (true) {
+        Clock::time_point now = Clock::now();
+        uint64_t available = channel.consumed;
+        size_t chunk = channel.firstChunk;
+        while (chunk < channel.chunks.size() && channel.chunks[chunk].deliveryTime <= now) {
+            available = channel.chunks[chunk++].end;
+        }
+
+        if (available > channel.consumed) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(count, available - channel.consumed));
+            std::copy_n(channel.bytes.begin() + channel.firstByte, n, data);
+            channel.firstByte += n;
+            channel.consumed += n;
+            while (channel.firstChunk < channel.chunks.size() && channel.chunks[channel.firstChunk].end <= channel.consumed) {
+                channel.firstChunk++;
+            }
+            compact(channel);
+            return static_cast<int>(n);
+        }
+        if (now >= deadline) {
+            return 0;
+        }
+
+        Clock::time_point wakeUp = deadline;
+        if (channel.firstChunk < channel.chunks.size()) {
+            wakeUp = std::min(wakeUp, channel.chunks[channel.firstChunk].deliveryTime);
+        }
+        channel.changed.wait_until(lock, wakeUp);
+    }
+}
+
+int LoopbackTransport::write(const uint8_t* data, size_t count) {
+    std::span<const uint8_t> buffer(data, count);
+    return writeGather(std::span(&buffer, 1));
+}
+
+// Wszystkie bufory trafiają na łącze jako jeden zapis, tak jak writev na porcie
+int LoopbackTransport::writeGather(std::span<const std::span<const uint8_t>> buffers) {
+    size_t count = 0;
+    for (auto buffer : buffers) {
+        count += buffer.size();
+    }
+
+    Channel& channel = *outgoing;
+    const LinkParameters& parameters = channel.parameters;
+    if (parameters.bytesPerSecond > 0) {
+        Clock::time_point busyUntil;
+        {
+            std::lock_guard lock(channel.mutex);
+            busyUntil = channel.busyUntil;
+        }
+        std::this_thread::sleep_until(busyUntil - std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(
+            TRANSMIT_BUFFER_SIZE * 1000000000ull / parameters.bytesPerSecond)));
+    }
+    std::lock_guard lock(channel.mutex);
+
+    Clock::time_point start = std::max(Clock::now(), channel.busyUntil);
+    Clock::duration transmission{0};
+    if (parameters.bytesPerSecond > 0) {
+        transmission = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::nanoseconds(count * 1000000000ull / parameters.bytesPerSecond));
+    }
+    channel.busyUntil = start + transmission;
+
+    for (auto buffer : buffers) {
+        channel.bytes.insert(channel.bytes.end(), buffer.begin(), buffer.end());
+    }
+    channel.written += count;
+    channel.chunks.push_back({channel.busyUntil + parameters.latency, channel.written});
+    channel.changed.notify_all();
+    return static_cast<int>(count);
+}
+
+void LoopbackTransport::flush() {
+    Clock::time_point busyUntil;
+    {
+        std::lock_guard lock(outgoing->mutex);
+        busyUntil = outgoing->busyUntil;
+    }
+    std::this_thread::sleep_until(busyUntil);
+}
+
+std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>>
+makeLoopbackPair(const LinkParameters& parameters) {
+    auto forward = std::make_shared<LoopbackTransport::Channel>();
+    auto backward = std::make_shared<LoopbackTransport::Channel>();
+    forward->parameters = parameters;
+    backward->parameters = parameters;
+
+    return {
+        std::make_unique<LoopbackTransport>(backward, forward),
+        std::make_unique<LoopbackTransport>(forward, backward)
+    };
+}
@@ -0,0 +1,38 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "transport.h"
+
+struct LinkParameters {
+    // 0 oznacza łącze bez ograniczenia przepustowości
+    uint64_t bytesPerSecond = 0;
+    std::chrono::microseconds latency{0};
+};
+
+// Jeden koniec łącza w pamięci procesu. Każdy zapis jest dostarczany drugiej stronie po czasie
+// potrzebnym na jego nadanie przy zadanej przepustowości plus stałe opóźnienie łącza.
+class LoopbackTransport : public Transport {
+public:
+    struct Channel;
+
+    LoopbackTransport(std::shared_ptr<Channel> incoming, std::shared_ptr<Channel> outgoing);
+
+    int read(uint8_t* data, size_t count, Clock::time_point deadline) override;
+    int write(const uint8_t* data, size_t count) override;
+    int writeGather(std::span<const std::span<const uint8_t>> buffers) override;
+    void flush() override;
+
+private:
+    std::shared_ptr<Channel> incoming;
+    std::shared_ptr<Channel> outgoing;
+};
+
+std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>>
+makeLoopbackPair(const LinkParameters& parameters);
+
+#endif
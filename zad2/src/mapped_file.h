@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Plik odwzorowany w pamięć tylko do odczytu, z podpowiedzią dla systemu, że będzie czytany
+// po kolei. Mapujemy tylko niepuste zwykłe pliki - dla pozostałych open() zwraca false.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool open(const std::string& path);
+
+    std::span<const uint8_t> data() const {
+        return {view, size};
+    }
+
+private:
+    const uint8_t* view = nullptr;
+    size_t size = 0;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    if (view) {
+        munmap(const_cast<uint8_t*>(view), size);
+    }
+}
+
+bool MappedFile::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0
+        || static_cast<uint64_t>(info.st_size) > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+
+    // odwzorowanie trzyma plik otwarty, deskryptor nie jest już potrzebny
+    size_t length = static_cast<size_t>(info.st_size);
+    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+
+    madvise(address, length, MADV_SEQUENTIAL);
+    view = static_cast<const uint8_t*>(address);
+    size = length;
+    return true;
+}
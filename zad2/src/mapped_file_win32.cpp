@@ -0,0 +1,42 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <windows.h>
+
+MappedFile::~MappedFile() {
+    if (view) {
+        UnmapViewOfFile(view);
+    }
+}
+
+bool MappedFile::open(const std::string& path) {
+    // FILE_FLAG_SEQUENTIAL_SCAN zwiększa read-ahead menedżera pamięci podręcznej także dla widoku
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER length;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &length) || length.QuadPart <= 0
+        || static_cast<uint64_t>(length.QuadPart) > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // widok trzyma odwzorowanie i plik otwarte, uchwyty nie są już potrzebne
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return false;
+    }
+    void* address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (address == NULL) {
+        return false;
+    }
+
+    view = static_cast<const uint8_t*>(address);
+    size = static_cast<size_t>(length.QuadPart);
+    return true;
+}
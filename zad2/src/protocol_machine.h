@@ -0,0 +1,78 @@
+#ifndef PROTOCOL_MACHINE_H
+#define PROTOCOL_MACHINE_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "transport.h"
+
+// Protokół jako maszyna stanów bez wejścia-wyjścia. feed() podaje bajty odebrane z łącza, poll()
+// obsługuje upływ terminu, a po każdym wywołaniu output() zawiera bajty do wysłania, a deadline()
+// termin, na który trzeba nastawić zegar. Żadna metoda nie blokuje, więc maszynę może napędzać
+// dowolna pętla zdarzeń, a test może podawać jej bajty po kolei bez wątków i prawdziwego czasu.
+class ProtocolMachine {
+public:
+    using Clock = Transport::Clock;
+
+    virtual ~ProtocolMachine() = default;
+
+    virtual void start(Clock::time_point now) = 0;
+    virtual void feed(std::span<const uint8_t> data, Clock::time_point now) = 0;
+    // Przed terminem z deadline() nic nie robi
+    void poll(Clock::time_point now) {
+        if (!done && now >= timer) {
+            expired(now);
+        }
+    }
+    // Łącze zgłosiło błąd albo zostało zamknięte przez drugą stronę
+    void abort() {
+        finish(false);
+    }
+
+    // Bajty do wysłania; kto napędza maszynę, zabiera je i czyści bufor
+    std::vector<uint8_t>& output() {
+        return pending;
+    }
+    Clock::time_point deadline() const {
+        return timer;
+    }
+    bool finished() const {
+        return done;
+    }
+    bool succeeded() const {
+        return success;
+    }
+
+protected:
+    virtual void expired(Clock::time_point now) = 0;
+    // Wywoływane raz, gdy maszyna kończy pracę
+    virtual void completed(bool) {
+    }
+
+    void send(std::span<const uint8_t> data) {
+        pending.insert(pending.end(), data.begin(), data.end());
+    }
+    void send(uint8_t byte) {
+        pending.push_back(byte);
+    }
+    void arm(Clock::time_point deadline) {
+        timer = deadline;
+    }
+    void finish(bool result) {
+        if (!done) {
+            done = true;
+            success = result;
+            timer = Clock::time_point::max();
+            completed(result);
+        }
+    }
+
+private:
+    std::vector<uint8_t> pending;
+    Clock::time_point timer = Clock::time_point::max();
+    bool done = false;
+    bool success = false;
+};
+
+#endif
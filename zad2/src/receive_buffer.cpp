@@ -0,0 +1,55 @@
+#include "receive_buffer.h"
+
+#include <algorithm>
+
+ReceiveBuffer::ReceiveBuffer(Transport& link, size_t readLimit) : link(link), readLimit(readLimit) {
+}
+
+bool ReceiveBuffer::fill(Transport::Clock::time_point deadline) {
+    if (count == data.size()) {
+        return false;
+    }
+
+    // wolne miejsce za końcem danych, bez zawijania - jedno read() na raz
+    size_t end = (start + count) % data.size();
+    size_t space = end >= start ? data.size() - end : start - end;
+    if (count == 0) {
+        start = 0;
+        end = 0;
+        space = data.size();
+    }
+
+    int result = link.read(data.data() + end, std::min(space, readLimit), deadline);
+    if (result <= 0) {
+        return false;
+    }
+    count += result;
+    return true;
+}
+
+bool ReceiveBuffer::fillTo(size_t length, Transport::Clock::time_point deadline) {
+    while (count < length) {
+        if (!fill(deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReceiveBuffer::copyTo(uint8_t* out, size_t offset, size_t length) const {
+    size_t first = (start + offset) % data.size();
+    size_t head = std::min(length, data.size() - first);
+    std::copy_n(data.begin() + first, head, out);
+    std::copy_n(data.begin(), length - head, out + head);
+}
+
+void ReceiveBuffer::consume(size_t length) {
+    length = std::min(length, count);
+    start = (start + length) % data.size();
+    count -= length;
+}
+
+void ReceiveBuffer::clear() {
+    start = 0;
+    count = 0;
+}
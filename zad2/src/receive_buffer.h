@@ -0,0 +1,50 @@
+#ifndef RECEIVE_BUFFER_H
+#define RECEIVE_BUFFER_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "transport.h"
+
+#define RECEIVE_BUFFER_SIZE 8192
+
+// Bufor pierścieniowy przed łączem: każde fill() zabiera z łącza wszystko, co już przyszło,
+// jednym wywołaniem read(), a protokół wyjmuje z niego całe ramki.
+class ReceiveBuffer {
+public:
+    // readLimit ogranicza jedno read() - nadawca czyta odpowiedzi po bajcie, żeby nie zabrać z łącza
+    // znaków, które należą już do dalszej części sesji
+    explicit ReceiveBuffer(Transport& link, size_t readLimit = RECEIVE_BUFFER_SIZE);
+
+    // Czeka najdłużej do deadline na nowe dane; false przy timeoucie, błędzie albo pełnym buforze.
+    bool fill(Transport::Clock::time_point deadline);
+    // Dopełnia bufor do co najmniej count bajtów.
+    bool fillTo(size_t count, Transport::Clock::time_point deadline);
+
+    size_t size() const {
+        return count;
+    }
+    uint8_t operator[](size_t index) const {
+        return data[(start + index) % data.size()];
+    }
+    // Dane od początku bufora do końca danych albo tablicy, bez zawijania
+    std::span<const uint8_t> readable() const {
+        return std::span(data).subspan(start, std::min(count, data.size() - start));
+    }
+
+    void copyTo(uint8_t* out, size_t offset, size_t length) const;
+    void consume(size_t length);
+    void clear();
+
+private:
+    Transport& link;
+    size_t readLimit;
+    std::array<uint8_t, RECEIVE_BUFFER_SIZE> data;
+    size_t start = 0;
+    size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <cstdint>
+#include <string>
+
+#include "transport.h"
+
+#define DEFAULT_BAUD_RATE 9600
+#define WRITE_TIMEOUT 10000
+#define WRITE_TIMEOUT_PER_BYTE 10
+
+extern const char* const defaultPort;
+
+// Otwiera i ustawia port (8 bitów, bez parzystości, surowy tryb); zwraca uchwyt systemowy albo -1.
+// Uchwyt asynchroniczny jest dla pętli zdarzeń: deskryptor nieblokujący w posix, uchwyt do operacji
+// overlapped w win32.
+intptr_t openSerialPort(const std::string& port, unsigned baudRate, bool asynchronous);
+void closeSerialPort(intptr_t handle);
+
+class SerialTransport : public Transport {
+public:
+    SerialTransport() = default;
+    SerialTransport(const SerialTransport&) = delete;
+    SerialTransport& operator=(const SerialTransport&) = delete;
+    ~SerialTransport() override;
+
+    bool open(const std::string& port, unsigned baudRate);
+
+    int read(uint8_t* data, size_t count, Clock::time_point deadline) override;
+    int write(const uint8_t* data, size_t count) override;
+    int writeGather(std::span<const std::span<const uint8_t>> buffers) override;
+    void flush() override;
+
+private:
+    // HANDLE w win32, deskryptor pliku w posix
+    intptr_t handle = -1;
+};
+
+#endif
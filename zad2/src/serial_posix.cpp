@@ -0,0 +1,221 @@
+#include "serial.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define MAX_GATHER_BUFFERS 8
+
+const char* const defaultPort = "/dev/ttyS0";
+
+#ifdef __linux__
+bool setCustomBaudRate(int fd, unsigned baudRate);
+#endif
+
+static speed_t standardSpeed(unsigned baudRate) {
+    switch (baudRate) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+#ifdef B1000000
+        case 1000000: return B1000000;
+#endif
+#ifdef B2000000
+        case 2000000: return B2000000;
+#endif
+#ifdef B3000000
+        case 3000000: return B3000000;
+#endif
+#ifdef B4000000
+        case 4000000: return B4000000;
+#endif
+        default: return B0;
+    }
+}
+
+static int pollFor(int fd, short events, int timeoutMs) {
+    pollfd pfd = { fd, events, 0 };
+    int result;
+    do {
+        result = poll(&pfd, 1, timeoutMs);
+    } while (result < 0 && errno == EINTR);
+    return result;
+}
+
+intptr_t openSerialPort(const std::string& port, unsigned baudRate, bool asynchronous) {
+    // O_NONBLOCK tylko na czas otwarcia, żeby nie czekać na DCD
+    int fd = ::open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return -1;
+    }
+    if (!asynchronous) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    }
+
+    termios tty{};
+    if (tcgetattr(fd, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    tty.c_cflag &= ~(CSTOPB | PARENB | CSIZE);
+    tty.c_cflag |= CS8 | CLOCAL | CREAD;
+    // timeouty realizuje poll(), read() ma wracać od razu z tym, co jest w buforze
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    speed_t speed = standardSpeed(baudRate);
+    if (speed != B0) {
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+    }
+    if (tcsetattr(fd, TCSANOW, &tty) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (speed == B0) {
+#ifdef __linux__
+        if (!setCustomBaudRate(fd, baudRate)) {
+            close(fd);
+            return -1;
+        }
+#else
+        close(fd);
+        return -1;
+#endif
+    }
+
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+void closeSerialPort(intptr_t handle) {
+    close(static_cast<int>(handle));
+}
+
+SerialTransport::~SerialTransport() {
+    if (handle >= 0) {
+        closeSerialPort(handle);
+    }
+}
+
+bool SerialTransport::open(const std::string& port, unsigned baudRate) {
+    handle = openSerialPort(port, baudRate, false);
+    return handle >= 0;
+}
+
+int SerialTransport::read(uint8_t* data, size_t count, Clock::time_point deadline) {
+    using namespace std::chrono;
+    int fd = static_cast<int>(handle);
+
+    while (true) {
+        // odległy termin (np. time_point::max()) nie mieści się w int milisekund poll()
+        auto remaining = duration_cast<milliseconds>(deadline - Clock::now()).count();
+        int ready = pollFor(fd, POLLIN, static_cast<int>(std::clamp<long long>(remaining, 0, INT_MAX)));
+        if (ready < 0) {
+            return -1;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+
+        ssize_t result = ::read(fd, data, count);
+        if (result > 0) {
+            return static_cast<int>(result);
+        }
+        // poll zgłosił gotowość, a nie ma danych - druga strona się rozłączyła
+        if (result == 0 || (errno != EINTR && errno != EAGAIN)) {
+            return -1;
+        }
+    }
+}
+
+int SerialTransport::write(const uint8_t* data, size_t count) {
+    int fd = static_cast<int>(handle);
+    size_t bytesWritten = 0;
+
+    while (bytesWritten < count) {
+        int ready = pollFor(fd, POLLOUT, WRITE_TIMEOUT + WRITE_TIMEOUT_PER_BYTE * static_cast<int>(count));
+        if (ready <= 0) {
+            break;
+        }
+
+        ssize_t result = ::write(fd, data + bytesWritten, count - bytesWritten);
+        if (result < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        bytesWritten += result;
+    }
+
+    return static_cast<int>(bytesWritten);
+}
+
+int SerialTransport::writeGather(std::span<const std::span<const uint8_t>> buffers) {
+    if (buffers.size() > MAX_GATHER_BUFFERS) {
+        return Transport::writeGather(buffers);
+    }
+
+    int fd = static_cast<int>(handle);
+    iovec vectors[MAX_GATHER_BUFFERS];
+    size_t count = 0;
+    size_t total = 0;
+    for (auto buffer : buffers) {
+        vectors[count++] = {const_cast<uint8_t*>(buffer.data()), buffer.size()};
+        total += buffer.size();
+    }
+
+    size_t bytesWritten = 0;
+    size_t first = 0;
+    while (bytesWritten < total) {
+        int ready = pollFor(fd, POLLOUT, WRITE_TIMEOUT + WRITE_TIMEOUT_PER_BYTE * static_cast<int>(total));
+        if (ready <= 0) {
+            break;
+        }
+
+        ssize_t result = ::writev(fd, vectors + first, static_cast<int>(count - first));
+        if (result < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -1;
+        }
+        bytesWritten += result;
+
+        // po częściowym zapisie pomijamy wysłane bufory i początek pierwszego niewysłanego
+        size_t remaining = static_cast<size_t>(result);
+        while (first < count && remaining >= vectors[first].iov_len) {
+            remaining -= vectors[first++].iov_len;
+        }
+        if (first < count) {
+            vectors[first].iov_base = static_cast<uint8_t*>(vectors[first].iov_base) + remaining;
+            vectors[first].iov_len -= remaining;
+        }
+    }
+
+    return static_cast<int>(bytesWritten);
+}
+
+void SerialTransport::flush() {
+    tcdrain(static_cast<int>(handle));
+}
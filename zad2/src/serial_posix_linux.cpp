@@ -0,0 +1,15 @@
+// termios2 z nagłówków jądra koliduje z <termios.h> z glibc, dlatego siedzi w osobnym pliku
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+bool setCustomBaudRate(int fd, unsigned baudRate) {
+    termios2 tty{};
+    if (ioctl(fd, TCGETS2, &tty) != 0) {
+        return false;
+    }
+    tty.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tty.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tty.c_ispeed = baudRate;
+    tty.c_ospeed = baudRate;
+    return ioctl(fd, TCSETS2, &tty) == 0;
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "serial.h"
+#include "xmodem.h"
+
+// Przesyłanie przez prawdziwy port szeregowy (termios) bez sprzętu: nadawca i odbiornik otwierają
+// strony podrzędne dwóch pseudoterminali, a wątek przekaźnika przepisuje bajty między ich stronami
+// głównymi jak kabel null-modem.
+
+#define TEST_FILE_SIZE (100 * 1024 + 100)
+#define RELAY_BUFFER_SIZE 4096
+
+// Para pseudoterminali połączonych przekaźnikiem. Po cutAfter bajtach od nadawcy do odbiornika
+// przekaźnik zamyka strony główne, więc obie strony widzą zerwane łącze.
+class PtyLink {
+public:
+    explicit PtyLink(uint64_t cutAfter = UINT64_MAX) : cutAfter(cutAfter) {
+        for (size_t i = 0; i < masters.size(); ++i) {
+            masters[i] = posix_openpt(O_RDWR | O_NOCTTY);
+            if (masters[i] < 0 || grantpt(masters[i]) != 0 || unlockpt(masters[i]) != 0) {
+                return;
+            }
+            ports[i] = ptsname(masters[i]);
+            // własny deskryptor strony podrzędnej: bez niego strona główna zgłasza błąd, dopóki
+            // transmisja nie otworzy portu
+            slaves[i] = ::open(ports[i].c_str(), O_RDWR | O_NOCTTY);
+        }
+        relay = std::thread([this] {
+            forward();
+        });
+    }
+
+    PtyLink(const PtyLink&) = delete;
+    PtyLink& operator=(const PtyLink&) = delete;
+
+    ~PtyLink() {
+        stopped = true;
+        if (relay.joinable()) {
+            relay.join();
+        }
+        closeMasters();
+        for (int slave : slaves) {
+            if (slave >= 0) {
+                close(slave);
+            }
+        }
+    }
+
+    bool valid() const {
+        return relay.joinable() && std::all_of(slaves.begin(), slaves.end(), [](int fd) { return fd >= 0; });
+    }
+
+    const std::string& receiverPort() const {
+        return ports[0];
+    }
+    const std::string& senderPort() const {
+        return ports[1];
+    }
+
+private:
+    void forward() {
+        std::array<uint8_t, RELAY_BUFFER_SIZE> buffer;
+        uint64_t forwarded = 0;
+
+        while (!stopped) {
+            std::array<pollfd, 2> fds = {pollfd{masters[0], POLLIN, 0}, pollfd{masters[1], POLLIN, 0}};
+            if (poll(fds.data(), fds.size(), 50) <= 0) {
+                continue;
+            }
+            for (size_t from = 0; from < fds.size(); ++from) {
+                if (!(fds[from].revents & POLLIN)) {
+                    continue;
+                }
+                ssize_t count = ::read(masters[from], buffer.data(), buffer.size());
+                if (count <= 0) {
+                    continue;
+                }
+                // od nadawcy (strona 1) do odbiornika (strona 0) liczymy bajty do zerwania łącza
+                if (from == 1) {
+                    count = static_cast<ssize_t>(std::min<uint64_t>(count, cutAfter - forwarded));
+                    forwarded += count;
+                }
+                if (!writeAll(masters[1 - from], buffer.data(), static_cast<size_t>(count))) {
+                    return;
+                }
+                if (forwarded >= cutAfter) {
+                    closeMasters();
+                    return;
+                }
+            }
+        }
+    }
+
+    static bool writeAll(int fd, const uint8_t* data, size_t count) {
+        while (count > 0) {
+            ssize_t result = ::write(fd, data, count);
+            if (result < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                return false;
+            }
+            data += result;
+            count -= result;
+        }
+        return true;
+    }
+
+    void closeMasters() {
+        for (int& master : masters) {
+            if (master >= 0) {
+                close(master);
+                master = -1;
+            }
+        }
+    }
+
+    uint64_t cutAfter;
+    std::array<int, 2> masters = {-1, -1};
+    std::array<int, 2> slaves = {-1, -1};
+    std::array<std::string, 2> ports;
+    std::atomic<bool> stopped{false};
+    std::thread relay;
+};
+
+std::vector<uint8_t> readWholeFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Jedna sesja: odbiornik i nadawca w osobnych wątkach, każdy na swoim porcie
+bool transfer(PtyLink& link, const std::filesystem::path& inputPath, const std::filesystem::path& outputPath,
+              const TransferOptions& options) {
+    SerialTransport receiverPort;
+    SerialTransport senderPort;
+    if (!link.valid() || !receiverPort.open(link.receiverPort(), DEFAULT_BAUD_RATE)
+        || !senderPort.open(link.senderPort(), DEFAULT_BAUD_RATE)) {
+        return false;
+    }
+
+    bool received = false;
+    std::thread receiver([&] {
+        received = receiveFile(receiverPort, outputPath.string(), options);
+    });
+    bool sent = sendFile(senderPort, inputPath.string(), options);
+    receiver.join();
+    return sent && received;
+}
+
+int main() {
+    auto directory = std::filesystem::temp_directory_path();
+    auto inputPath = directory / "xmodem_serial_in.bin";
+    auto outputPath = directory / "xmodem_serial_out.bin";
+    auto checkpointPath = directory / "xmodem_serial_out.bin.xmc";
+
+    std::vector<uint8_t> input(TEST_FILE_SIZE);
+    std::mt19937 generator(54321);
+    for (auto& byte : input) {
+        byte = static_cast<uint8_t>(generator());
+    }
+    if (input.back() == 0x1A) {
+        input.back() = 0;
+    }
+    std::ofstream(inputPath, std::ios::binary).write(reinterpret_cast<const char*>(input.data()), input.size());
+
+    struct Case {
+        const char* name;
+        TransferOptions options;
+        // po ilu bajtach zerwać pierwszą sesję; 0 - bez zerwania
+        uint64_t cutAfter;
+    };
+    TransferOptions crc;
+    crc.crc = true;
+    TransferOptions oneK = crc;
+    oneK.oneK = true;
+    oneK.trimPadding = true;
+    TransferOptions resume = oneK;
+    resume.resume = true;
+    const Case cases[] = {
+        {"CRC16", crc, 0},
+        {"XMODEM-1K", oneK, 0},
+        {"wznowienie", resume, TEST_FILE_SIZE / 2},
+    };
+
+    bool allPassed = true;
+    for (const auto& test : cases) {
+        std::filesystem::remove(outputPath);
+        std::filesystem::remove(checkpointPath);
+
+        bool interrupted = true;
+        if (test.cutAfter > 0) {
+            PtyLink link(test.cutAfter);
+            interrupted = !transfer(link, inputPath, outputPath, test.options) && std::filesystem::exists(checkpointPath);
+        }
+        PtyLink link;
+        bool correct = interrupted && transfer(link, inputPath, outputPath, test.options);
+
+        // bez obcinania dopełnienia plik kończy się 0x1A do granicy bloku
+        std::vector<uint8_t> output = readWholeFile(outputPath);
+        size_t expected = test.options.trimPadding ? input.size()
+                                                   : (input.size() + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        correct = correct && output.size() == expected && std::equal(input.begin(), input.end(), output.begin())
+            && std::all_of(output.begin() + input.size(), output.end(), [](uint8_t byte) { return byte == 0x1A; })
+            && !std::filesystem::exists(checkpointPath);
+        allPassed = allPassed && correct;
+        std::cout << test.name << ": " << (correct ? "poprawnie" : "BŁĄD") << std::endl;
+    }
+
+    std::filesystem::remove(inputPath);
+    std::filesystem::remove(outputPath);
+    return allPassed ? 0 : 1;
+}
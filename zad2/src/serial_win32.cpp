@@ -0,0 +1,123 @@
+#include "serial.h"
+
+#include <algorithm>
+#include <windows.h>
+
+#define READ_POLL_INTERVAL 50
+#define GATHER_BUFFER_SIZE 2048
+
+const char* const defaultPort = "COM1";
+
+static HANDLE toHandle(intptr_t handle) {
+    return reinterpret_cast<HANDLE>(handle);
+}
+
+intptr_t openSerialPort(const std::string& port, unsigned baudRate, bool asynchronous) {
+    HANDLE hSerial = CreateFileA(port.c_str(),GENERIC_WRITE | GENERIC_READ, 0,
+        NULL, OPEN_EXISTING, asynchronous ? FILE_FLAG_OVERLAPPED : FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hSerial == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    DCB dcbSerialParams = { 0 };
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+    GetCommState(hSerial, &dcbSerialParams);
+    dcbSerialParams.BaudRate = baudRate;
+    dcbSerialParams.ByteSize = 8;
+    dcbSerialParams.StopBits = ONESTOPBIT;
+    dcbSerialParams.Parity = NOPARITY;
+    if (!SetCommState(hSerial, &dcbSerialParams)) {
+        CloseHandle(hSerial);
+        return -1;
+    }
+
+    COMMTIMEOUTS timeouts = { 0 };
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    if (asynchronous) {
+        // odczyt overlapped kończy się z pierwszymi bajtami, które przyjdą; terminy pilnuje pętla zdarzeń
+        timeouts.ReadTotalTimeoutConstant = MAXDWORD - 1;
+    } else {
+        // ReadFile wraca od razu z tym, co jest w buforze, a gdy bufor jest pusty - z pierwszym bajtem,
+        // który przyjdzie w ciągu READ_POLL_INTERVAL; dłuższe czekanie robi pętla w read()
+        timeouts.ReadTotalTimeoutConstant = READ_POLL_INTERVAL;
+        timeouts.WriteTotalTimeoutConstant = WRITE_TIMEOUT;
+        timeouts.WriteTotalTimeoutMultiplier = WRITE_TIMEOUT_PER_BYTE;
+    }
+    if (!SetCommTimeouts(hSerial, &timeouts)) {
+        CloseHandle(hSerial);
+        return -1;
+    }
+    return reinterpret_cast<intptr_t>(hSerial);
+}
+
+void closeSerialPort(intptr_t handle) {
+    CloseHandle(toHandle(handle));
+}
+
+SerialTransport::~SerialTransport() {
+    if (toHandle(handle) != INVALID_HANDLE_VALUE) {
+        closeSerialPort(handle);
+    }
+}
+
+bool SerialTransport::open(const std::string& port, unsigned baudRate) {
+    handle = openSerialPort(port, baudRate, false);
+    return toHandle(handle) != INVALID_HANDLE_VALUE;
+}
+
+int SerialTransport::read(uint8_t* data, size_t count, Clock::time_point deadline) {
+    do {
+        // Po terminie (także przy samym sprawdzeniu, czy coś czeka) ReadFile z pustym buforem stałby
+        // READ_POLL_INTERVAL, więc bierzemy tylko to, co już jest w kolejce portu
+        if (Clock::now() >= deadline) {
+            COMSTAT status = { 0 };
+            DWORD errors = 0;
+            if (!ClearCommError(toHandle(handle), &errors, &status)) {
+                return -1;
+            }
+            if (status.cbInQue == 0) {
+                return 0;
+            }
+            count = std::min<size_t>(count, status.cbInQue);
+        }
+        DWORD bytesRead = 0;
+        if (!ReadFile(toHandle(handle), data, static_cast<DWORD>(count), &bytesRead, NULL)) {
+            return -1;
+        }
+        if (bytesRead > 0) {
+            return static_cast<int>(bytesRead);
+        }
+    } while (Clock::now() < deadline);
+
+    return 0;
+}
+
+int SerialTransport::write(const uint8_t* data, size_t count) {
+    DWORD bytesWritten = 0;
+
+    if (!WriteFile(toHandle(handle), data, static_cast<DWORD>(count), &bytesWritten, NULL)) {
+        return -1;
+    }
+
+    return static_cast<int>(bytesWritten);
+}
+
+// WriteFileGather wymaga pliku otwartego bez buforowania i buforów wielkości strony, więc nie działa
+// z portem COM. Ramkę składamy na stosie i wysyłamy jednym WriteFile, czyli jednym wywołaniem systemowym.
+int SerialTransport::writeGather(std::span<const std::span<const uint8_t>> buffers) {
+    uint8_t gathered[GATHER_BUFFER_SIZE];
+    size_t total = 0;
+    for (auto buffer : buffers) {
+        if (total + buffer.size() > sizeof(gathered)) {
+            return Transport::writeGather(buffers);
+        }
+        std::copy(buffer.begin(), buffer.end(), gathered + total);
+        total += buffer.size();
+    }
+    return write(gathered, total);
+}
+
+void SerialTransport::flush() {
+    FlushFileBuffers(toHandle(handle));
+}
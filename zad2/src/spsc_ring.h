@@ -0,0 +1,72 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Pierścień slotów między jednym producentem a jednym konsumentem, bez blokad. Producent wypełnia
+// slot z claim() i oddaje go przez publish(), konsument bierze go przez take() i zwalnia przez
+// release() - niekoniecznie od razu, ale zawsze w kolejności pobrania. Na pełnym albo pustym
+// pierścieniu strona czeka (atomic::wait) na zmianę licznika drugiej strony.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : slots(capacity) {
+    }
+
+    // Wolny slot do wypełnienia albo nullptr po cancel()
+    T* claim() {
+        size_t free;
+        while (claimed - (free = released.load(std::memory_order_acquire)) >= slots.size()) {
+            if (cancelled) {
+                return nullptr;
+            }
+            released.wait(free, std::memory_order_acquire);
+        }
+        return cancelled ? nullptr : &slots[claimed % slots.size()];
+    }
+
+    void publish() {
+        claimed++;
+        produced.fetch_add(1, std::memory_order_release);
+        produced.notify_one();
+    }
+
+    // Najstarszy opublikowany slot albo nullptr po cancel()
+    T* take() {
+        size_t available;
+        while ((available = produced.load(std::memory_order_acquire)) == taken) {
+            if (cancelled) {
+                return nullptr;
+            }
+            produced.wait(available, std::memory_order_acquire);
+        }
+        return cancelled ? nullptr : &slots[taken++ % slots.size()];
+    }
+
+    void release() {
+        released.fetch_add(1, std::memory_order_release);
+        released.notify_one();
+    }
+
+    // Budzi obie strony; liczniki przesuwamy o cały pierścień, bo atomic::wait wraca dopiero po zmianie wartości
+    void cancel() {
+        cancelled = true;
+        released.fetch_add(slots.size(), std::memory_order_release);
+        released.notify_one();
+        produced.fetch_add(slots.size(), std::memory_order_release);
+        produced.notify_one();
+    }
+
+private:
+    std::vector<T> slots;
+    std::atomic<size_t> produced{0};
+    std::atomic<size_t> released{0};
+    std::atomic<bool> cancelled{false};
+    // claimed zna tylko producent, taken tylko konsument
+    size_t claimed = 0;
+    size_t taken = 0;
+};
+
+#endif
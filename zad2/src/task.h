@@ -0,0 +1,104 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// Leniwa korutyna zwracająca T. Rusza dopiero po co_await (albo start() dla korutyny najwyższego
+// poziomu), a po co_return od razu wznawia tego, kto na nią czekał, bez przechodzenia przez planistę.
+template <typename T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        auto final_suspend() noexcept {
+            struct FinalAwaiter {
+                bool await_ready() noexcept {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                    return handle.promise().continuation;
+                }
+                void await_resume() noexcept {
+                }
+            };
+            return FinalAwaiter{};
+        }
+        void return_value(T result) {
+            value = std::move(result);
+        }
+        // Kod protokołu nie rzuca wyjątków; wyjątek z biblioteki standardowej kończy program jak poza korutyną
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        reset();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept {
+                return handle.done();
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() {
+                return std::move(*handle.promise().value);
+            }
+        };
+        return Awaiter{handle};
+    }
+
+    // Uruchamia korutynę najwyższego poziomu do pierwszego zawieszenia
+    void start() {
+        handle.resume();
+    }
+    bool done() const {
+        return handle.done();
+    }
+    T& result() {
+        return *handle.promise().value;
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {
+    }
+
+    void reset() {
+        if (handle) {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+class Transport {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~Transport() = default;
+
+    // Czeka najdłużej do deadline na jakiekolwiek dane i zwraca od 1 do count bajtów,
+    // 0 gdy nic nie przyszło przed deadline, -1 przy błędzie. Deadline, który już minął, to samo
+    // sprawdzenie bufora - read() nie może wtedy czekać, bo nadawcy strumieniowi pytają tak po każdym bloku.
+    virtual int read(uint8_t* data, size_t count, Clock::time_point deadline) = 0;
+    // Zwraca liczbę zapisanych bajtów albo -1 przy błędzie.
+    virtual int write(const uint8_t* data, size_t count) = 0;
+    // Zapisuje kolejno kilka buforów tak, jakby były jednym; domyślnie wywołuje write() dla każdego.
+    virtual int writeGather(std::span<const std::span<const uint8_t>> buffers) {
+        int total = 0;
+        for (auto buffer : buffers) {
+            int result = write(buffer.data(), buffer.size());
+            if (result < 0) {
+                return -1;
+            }
+            total += result;
+            if (static_cast<size_t>(result) < buffer.size()) {
+                break;
+            }
+        }
+        return total;
+    }
+    // Czeka, aż wszystkie zapisane dane zostaną wysłane.
+    virtual void flush() = 0;
+};
+
+#endif
@@ -0,0 +1,1546 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "xmodem.h"
+#include "crc.h"
+#include "file_sync.h"
+#include "mapped_file.h"
+#include "receive_buffer.h"
+#include "spsc_ring.h"
+#include "xmodem_machine.h"
+#include "xmodem_protocol.h"
+
+using namespace Control;
+
+// 'R', przesunięcie (16 cyfr), długość i CRC16 ostatniego odebranego bloku (po 4 cyfry)
+#define RESUME_REQUEST_SIZE 25
+#define CHECKPOINT_INTERVAL 32
+#define CHECKPOINT_SUFFIX ".xmc"
+#define READ_AHEAD_BLOCKS 16
+#define WRITE_BEHIND_BLOCKS 64
+#define STRIPE_SIZE (64 * 1024)
+
+int readWithTimeout(Transport& link, std::span<uint8_t> buffer) {
+    size_t count = buffer.size();
+    auto deadline = Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT + TIMEOUT_PER_BYTE * count);
+    size_t bytesRead = 0;
+
+    while (bytesRead < count) {
+        int result = link.read(buffer.data() + bytesRead, count - bytesRead, deadline);
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            break;
+        }
+        bytesRead += result;
+    }
+
+    return static_cast<int>(bytesRead);
+}
+
+int writeAll(Transport& link, std::span<const uint8_t> buffer) {
+    return link.write(buffer.data(), buffer.size());
+}
+
+void purgeInput(Transport& link) {
+    uint8_t scratch[256];
+
+    while (link.read(scratch, sizeof(scratch), Transport::Clock::now() + std::chrono::milliseconds(PURGE_TIMEOUT)) > 0) {
+    }
+}
+
+int readByteWithTimeout(Transport& link, uint8_t& byte) {
+    return readWithTimeout(link, std::span(&byte, 1));
+}
+
+int writeByte(Transport& link, uint8_t byte) {
+    return writeAll(link, std::span(&byte, 1));
+}
+
+void cancelTransfer(Transport& link) {
+    std::array<uint8_t, 2> cancel = {CAN, CAN};
+    writeAll(link, cancel);
+}
+
+int readWindowReply(Transport& link, uint8_t& response, uint8_t& blockNumber) {
+    if (readByteWithTimeout(link, response) <= 0) {
+        return -1;
+    }
+    if (response != ACK && response != NAK) {
+        return 1;
+    }
+
+    std::array<uint8_t, 2> number;
+    if (readWithTimeout(link, number) != 2 || number[0] + number[1] != 255) {
+        return 0;
+    }
+    blockNumber = number[0];
+    return 3;
+}
+
+int writeWindowReply(Transport& link, uint8_t response, uint8_t blockNumber) {
+    std::array<uint8_t, 3> reply = {response, blockNumber, static_cast<uint8_t>(255 - blockNumber)};
+    return writeAll(link, reply);
+}
+
+bool writePacket(Transport& link, const Packet& packet) {
+    std::array<std::span<const uint8_t>, 3> parts = {packet.header, packet.block,
+                                                     std::span(packet.trailer).first(packet.trailerSize)};
+    size_t size = packet.header.size() + packet.block.size() + packet.trailerSize;
+    return link.writeGather(parts) == static_cast<int>(size);
+}
+
+bool writeOutput(Transport& link, ProtocolMachine& machine) {
+    std::vector<uint8_t>& output = machine.output();
+    bool written = output.empty() || writeAll(link, output) >= 0;
+    output.clear();
+    return written;
+}
+
+// Ramkę nadawcy wysyłamy jednym zapisem z trzech buforów, wprost z pierścienia wątku czytającego
+template <typename Policy>
+bool writeOutput(Transport& link, XmodemSender<Policy>& sender) {
+    const Packet* frame = sender.takeFrame();
+    return (!frame || writePacket(link, *frame)) && writeOutput(link, static_cast<ProtocolMachine&>(sender));
+}
+
+// Blokujące łącze napędzające maszynę protokołu. Maszyna dostaje wprost z bufora tyle bajtów, ile
+// zostało do końca bieżącej ramki, więc to, co przyszło za ostatnią ramką, zostaje w input dla
+// dalszej części sesji.
+template <typename Machine>
+bool runMachine(Transport& link, ReceiveBuffer& input, Machine& machine) {
+    while (true) {
+        if (!writeOutput(link, machine)) {
+            machine.abort();
+        }
+        if (machine.finished()) {
+            return machine.succeeded();
+        }
+
+        if (input.size() == 0 && !input.fill(machine.deadline())) {
+            // przed terminem read() wraca bez danych tylko przy błędzie łącza
+            auto now = Transport::Clock::now();
+            if (now < machine.deadline()) {
+                machine.abort();
+            } else {
+                machine.poll(now);
+            }
+            continue;
+        }
+        std::span<const uint8_t> data = input.readable();
+        data = data.first(machine.frameLength(data));
+        machine.feed(data, Transport::Clock::now());
+        input.consume(data.size());
+    }
+}
+
+enum class FrameStatus {
+    Block,
+    EndOfTransmission,
+    Cancel,
+    Corrupted,
+    Timeout
+};
+
+struct Frame {
+    FrameStatus status;
+    uint8_t blockNumber;
+    size_t blockSize;
+    bool checkValid;
+};
+
+// Wyjmuje z bufora jedną całą ramkę. Dane bloku trafiają do dataBlock, a do łącza sięgamy tylko
+// wtedy, gdy ramka nie przyszła jeszcze w całości.
+template <typename Policy>
+Frame receiveFrame(ReceiveBuffer& input, std::span<uint8_t> dataBlock) {
+    Frame frame = {FrameStatus::Timeout, 0, 0, false};
+
+    if (!input.fillTo(1, Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT))) {
+        return frame;
+    }
+
+    uint8_t headerByte = input[0];
+    if (headerByte == EOT || headerByte == CAN) {
+        input.consume(1);
+        frame.status = headerByte == EOT ? FrameStatus::EndOfTransmission : FrameStatus::Cancel;
+        return frame;
+    }
+
+    frame.status = FrameStatus::Corrupted;
+    if (headerByte != SOH && headerByte != STX) {
+        return frame;
+    }
+
+    frame.blockSize = blockSizeFor(headerByte);
+    size_t frameSize = 3 + frame.blockSize + Policy::trailerSize;
+    auto deadline = Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT + TIMEOUT_PER_BYTE * frameSize);
+    if (!input.fillTo(frameSize, deadline) || input[1] + input[2] != 255) {
+        return frame;
+    }
+
+    frame.status = FrameStatus::Block;
+    frame.blockNumber = input[1];
+    std::span<uint8_t> data = dataBlock.first(frame.blockSize);
+    input.copyTo(data.data(), 3, frame.blockSize);
+
+    std::array<uint8_t, Policy::trailerSize> trailer;
+    input.copyTo(trailer.data(), 3 + frame.blockSize, trailer.size());
+    frame.checkValid = Policy::check(data, trailer.data());
+    input.consume(frameSize);
+    return frame;
+}
+
+// Stan odbioru zapisywany obok pliku wyjściowego, żeby po zerwaniu połączenia nie zaczynać od bloku 1
+struct Checkpoint {
+    uint64_t blocks = 0;
+    uint64_t bytes = 0;
+    uint32_t lastLength = 0;
+    uint16_t lastCRC = 0;
+};
+
+// Sprawdza, czy plik zaczyna się od bloków opisanych w checkpoincie - porównuje CRC ostatniego z nich
+bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+    std::ifstream sidecar(path + CHECKPOINT_SUFFIX);
+    if (!(sidecar >> checkpoint.blocks >> checkpoint.bytes >> checkpoint.lastLength >> checkpoint.lastCRC)
+        || checkpoint.lastLength == 0 || checkpoint.lastLength > BLOCK_SIZE_1K
+        || checkpoint.lastLength > checkpoint.bytes) {
+        return false;
+    }
+
+    std::ifstream partial(path, std::ios::binary);
+    std::array<uint8_t, BLOCK_SIZE_1K> block;
+    partial.seekg(static_cast<std::streamoff>(checkpoint.bytes - checkpoint.lastLength));
+    partial.read(reinterpret_cast<char*>(block.data()), checkpoint.lastLength);
+    return static_cast<size_t>(partial.gcount()) == checkpoint.lastLength
+        && calculateCRC16(block.data(), checkpoint.lastLength) == checkpoint.lastCRC;
+}
+
+// Obcina plik za blokami z checkpointu, zanim poprosimy nadawcę o wznowienie. Gdy się nie da (brak
+// uprawnień, plik usunięty po zapisaniu checkpointu), checkpoint jest nieaktualny - usuwamy go
+// i odbieramy plik od początku.
+bool truncateToCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+    std::error_code error;
+    std::filesystem::resize_file(path, checkpoint.bytes, error);
+    if (error) {
+        std::filesystem::remove(path + CHECKPOINT_SUFFIX, error);
+        return false;
+    }
+    return true;
+}
+
+// Plik wyjściowy odbiornika. Gdy nadawca podał długość pliku, zapis kończy się na niej,
+// więc dopełnienie 0x1A z ostatniego bloku nie trafia na dysk; bez długości, z opcją trimPadding,
+// ostatni blok czeka w pamięci do EOT i zapisujemy go bez końcowych 0x1A. Bloki trafiają na dysk
+// z wątku zapisującego, żeby wolny dysk nie opóźniał potwierdzeń - write() tylko kopiuje blok.
+class OutputFile {
+public:
+    OutputFile(const std::string& path, const TransferOptions& options)
+        : OutputFile(path, Checkpoint(), "", options) {
+    }
+
+    // Odbiór z checkpointami; przy niepustym start dopisuje za już odebranymi blokami
+    OutputFile(const std::string& path, const Checkpoint& start, const TransferOptions& options)
+        : OutputFile(path, start, path + CHECKPOINT_SUFFIX, options) {
+    }
+
+    // Fragment istniejącego pliku przy odbiorze na kilku łączach: length bajtów od offset
+    OutputFile(const std::string& path, uint64_t offset, uint64_t length, const TransferOptions& options)
+        : OutputFile(path, Checkpoint(), "", std::ios::binary | std::ios::in | std::ios::out, options) {
+        stream.seekp(static_cast<std::streamoff>(offset));
+        setLength(length);
+    }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    ~OutputFile() {
+        stopWriter();
+    }
+
+    void setLength(uint64_t length) {
+        remaining = length;
+        trimPadding = false;
+    }
+
+    // false, gdy wcześniejszy zapis się nie udał i dalszy odbiór nie ma sensu
+    bool write(std::span<const uint8_t> data) {
+        if (!trimPadding) {
+            return enqueue(data);
+        }
+        if (heldSize > 0 && !enqueue(std::span(held.data(), heldSize))) {
+            return false;
+        }
+        std::copy(data.begin(), data.end(), held.begin());
+        heldSize = data.size();
+        return true;
+    }
+
+    // Czeka na zapis wszystkich bloków. Po udanym odbiorze zamyka plik, na życzenie wymusza zapis
+    // na dysk i usuwa zbędny już checkpoint; po nieudanym zapisuje stan z ostatniego bloku.
+    bool finish(bool complete) {
+        if (heldSize > 0) {
+            size_t length = heldSize;
+            while (complete && length > 0 && held[length - 1] == 0x1A) {
+                length--;
+            }
+            if (length > 0) {
+                enqueue(std::span(held.data(), length));
+            }
+            heldSize = 0;
+        }
+        stopWriter();
+        if (!complete) {
+            saveCheckpoint();
+            return false;
+        }
+
+        stream.close();
+        if (failed || stream.fail() || (sync && !syncFile(path))) {
+            return false;
+        }
+        if (!checkpointPath.empty()) {
+            std::error_code error;
+            std::filesystem::remove(checkpointPath, error);
+        }
+        return true;
+    }
+
+private:
+    OutputFile(const std::string& path, const Checkpoint& start, const std::string& checkpointPath,
+               const TransferOptions& options)
+        : OutputFile(path, start, checkpointPath,
+                     std::ios::binary | (start.bytes > 0 ? std::ios::app : std::ios::trunc), options) {
+    }
+
+    // Wątek zapisujący dotyka strumienia dopiero po pierwszym bloku z pierścienia, więc konstruktor
+    // może jeszcze ustawić pozycję zapisu
+    OutputFile(const std::string& path, const Checkpoint& start, const std::string& checkpointPath,
+               std::ios::openmode mode, const TransferOptions& options)
+        : path(path), stream(path, mode),
+          checkpointPath(checkpointPath), checkpoint(start), sync(options.sync), trimPadding(options.trimPadding),
+          ring(WRITE_BEHIND_BLOCKS) {
+        writer = std::thread([this] {
+            drain();
+        });
+    }
+
+    struct PendingBlock {
+        std::array<uint8_t, BLOCK_SIZE_1K> data;
+        size_t size;
+    };
+
+    bool enqueue(std::span<const uint8_t> data) {
+        if (failed) {
+            return false;
+        }
+        PendingBlock* block = ring.claim();
+        std::copy(data.begin(), data.end(), block->data.begin());
+        block->size = data.size();
+        ring.publish();
+        return true;
+    }
+
+    // blok o zerowej długości kończy pracę wątku zapisującego
+    void stopWriter() {
+        if (!writer.joinable()) {
+            return;
+        }
+        ring.claim()->size = 0;
+        ring.publish();
+        writer.join();
+    }
+
+    // Po błędzie zapisu wątek dalej zwalnia sloty, żeby odbiornik nie czekał na miejsce w pierścieniu
+    void drain() {
+        while (PendingBlock* block = ring.take()) {
+            size_t size = block->size;
+            if (size > 0 && !failed) {
+                store(std::span(block->data.data(), size));
+            }
+            ring.release();
+            if (size == 0) {
+                return;
+            }
+        }
+    }
+
+    void store(std::span<const uint8_t> data) {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(data.size(), remaining));
+        if (!stream.write(reinterpret_cast<const char*>(data.data()), length)) {
+            failed = true;
+            return;
+        }
+        remaining -= length;
+
+        if (!checkpointPath.empty() && length > 0) {
+            checkpoint.blocks++;
+            checkpoint.bytes += length;
+            checkpoint.lastLength = static_cast<uint32_t>(length);
+            checkpoint.lastCRC = calculateCRC16(data.first(length));
+            if (checkpoint.blocks % CHECKPOINT_INTERVAL == 0) {
+                saveCheckpoint();
+            }
+        }
+    }
+
+    // Checkpoint nie może opisywać bloków, których nie ma jeszcze na dysku, więc najpierw flush,
+    // a nowy stan podmieniamy przez rename, żeby przerwanie w trakcie nie zostawiło uciętego pliku
+    void saveCheckpoint() {
+        if (checkpointPath.empty() || checkpoint.blocks == 0 || !stream.flush()) {
+            return;
+        }
+        std::string temporaryPath = checkpointPath + ".tmp";
+        {
+            std::ofstream sidecar(temporaryPath);
+            sidecar << checkpoint.blocks << ' ' << checkpoint.bytes << ' ' << checkpoint.lastLength << ' '
+                    << checkpoint.lastCRC << std::endl;
+            if (!sidecar) {
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, checkpointPath, error);
+    }
+
+    std::string path;
+    std::ofstream stream;
+    uint64_t remaining = UINT64_MAX;
+    std::string checkpointPath;
+    Checkpoint checkpoint;
+    bool sync;
+    bool trimPadding;
+    std::array<uint8_t, BLOCK_SIZE_1K> held;
+    size_t heldSize = 0;
+    std::atomic<bool> failed{false};
+    SpscRing<PendingBlock> ring;
+    std::thread writer;
+};
+
+void purgeInput(Transport& link, ReceiveBuffer& input) {
+    input.clear();
+    purgeInput(link);
+}
+
+template <typename Policy>
+bool receiveBlocksWindowed(Transport& link, ReceiveBuffer& input, OutputFile& output) {
+    // blok o numerze n czeka w pending[n % WINDOW_MAX]; 256 dzieli się przez WINDOW_MAX,
+    // więc bloki z jednego okna nigdy nie trafiają do tego samego miejsca
+    uint8_t expectedBlock = 1;
+    std::vector<std::array<uint8_t, BLOCK_SIZE_1K>> pending(WINDOW_MAX);
+    std::array<size_t, WINDOW_MAX> pendingSize{};
+    int pendingCount = 0;
+    std::array<uint8_t, BLOCK_SIZE_1K> dataBlock;
+
+    int timeouts = 0;
+    while (true) {
+        Frame frame = receiveFrame<Policy>(input, dataBlock);
+
+        if (frame.status == FrameStatus::Timeout) {
+            if (++timeouts >= MAX_RETRIES) {
+                return false;
+            }
+            continue;
+        }
+        timeouts = 0;
+
+        if (frame.status == FrameStatus::EndOfTransmission && pendingCount == 0) {
+            writeWindowReply(link, ACK, expectedBlock);
+            break;
+        }
+        if (frame.status == FrameStatus::Cancel) {
+            return false;
+        }
+
+        if (frame.status != FrameStatus::Block) {
+            // zgubiliśmy synchronizację i nie wiadomo, których bloków dotyczy błąd - czyścimy linię
+            // i prosimy o wszystkie brakujące bloki z okna, nadawca pominie te, których nie wysłał
+            purgeInput(link, input);
+            for (int i = 0; i < WINDOW_MAX; ++i) {
+                uint8_t missing = expectedBlock + i;
+                if (pendingSize[missing % WINDOW_MAX] == 0) {
+                    writeWindowReply(link, NAK, missing);
+                }
+            }
+            continue;
+        }
+
+        uint8_t offset = frame.blockNumber - expectedBlock;
+        if (!frame.checkValid) {
+            writeWindowReply(link, NAK, frame.blockNumber);
+        } else if (offset < WINDOW_MAX) {
+            size_t slot = frame.blockNumber % WINDOW_MAX;
+            if (pendingSize[slot] == 0) {
+                std::copy_n(dataBlock.begin(), frame.blockSize, pending[slot].begin());
+                pendingSize[slot] = frame.blockSize;
+                pendingCount++;
+            }
+            writeWindowReply(link, ACK, frame.blockNumber);
+
+            for (slot = expectedBlock % WINDOW_MAX; pendingSize[slot] != 0; slot = expectedBlock % WINDOW_MAX) {
+                if (!output.write(std::span(pending[slot].data(), pendingSize[slot]))) {
+                    cancelTransfer(link);
+                    return false;
+                }
+                pendingSize[slot] = 0;
+                pendingCount--;
+                expectedBlock++;
+            }
+        } else if (offset >= 256 - WINDOW_MAX) {
+            writeWindowReply(link, ACK, frame.blockNumber);
+        }
+    }
+
+    return true;
+}
+
+// XMODEM-G: po 'G' nadawca wysyła bloki bez czekania na potwierdzenia, więc każdy błąd
+// kończy transmisję - zakładamy, że błędy poprawia już niższa warstwa łącza
+template <typename Policy>
+bool receiveBlocksStreaming(Transport& link, ReceiveBuffer& input, OutputFile& output) {
+    uint8_t expectedBlock = 1;
+    std::array<uint8_t, BLOCK_SIZE_1K> dataBlock;
+
+    while (true) {
+        Frame frame = receiveFrame<Policy>(input, dataBlock);
+
+        if (frame.status == FrameStatus::EndOfTransmission) {
+            writeByte(link, ACK);
+            break;
+        }
+        if (frame.status == FrameStatus::Cancel) {
+            return false;
+        }
+        if (frame.status != FrameStatus::Block || !frame.checkValid || frame.blockNumber != expectedBlock) {
+            cancelTransfer(link);
+            return false;
+        }
+
+        if (!output.write(std::span(dataBlock.data(), frame.blockSize))) {
+            cancelTransfer(link);
+            return false;
+        }
+        expectedBlock++;
+    }
+
+    return true;
+}
+
+// Zwykły XMODEM to ta sama maszyna stanów co w demonie; znak inicjujący wysłało już startTransfer
+template <typename Policy>
+bool receiveBlocks(Transport& link, ReceiveBuffer& input, OutputFile& output) {
+    XmodemReceiver<Policy> receiver([&output](std::span<const uint8_t> block) {
+        return output.write(block);
+    });
+    receiver.startReceiving(Transport::Clock::now());
+    return runMachine(link, input, receiver);
+}
+
+uint8_t initiationByte(const TransferOptions& options) {
+    if (options.windowSize > 0) {
+        return W;
+    }
+    if (options.streaming) {
+        return G;
+    }
+    return (options.crc || options.crc32) ? C : NAK;
+}
+
+// Znak inicjujący wybiera tryb: NAK - suma kontrolna, C - CRC16, W - okno, G - strumień
+bool startTransfer(Transport& link, ReceiveBuffer& input, uint8_t initiation) {
+    for (int i = 0; i < 6; ++i) {
+        writeByte(link, initiation);
+
+        if (input.size() > 0 || input.fill(Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Policy>
+bool receiveBlocksWith(Transport& link, ReceiveBuffer& input, OutputFile& output, uint8_t initiation) {
+    switch (initiation) {
+        case W:
+            return receiveBlocksWindowed<Policy>(link, input, output);
+        case G:
+            return receiveBlocksStreaming<Policy>(link, input, output);
+        default:
+            return receiveBlocks<Policy>(link, input, output);
+    }
+}
+
+// Znak inicjujący wybiera tryb przesyłania, a wynegocjowane wcześniej CRC-32C zastępuje w nim CRC16
+bool receiveData(Transport& link, ReceiveBuffer& input, OutputFile& output, uint8_t initiation, bool crc32) {
+    if (crc32) {
+        return receiveBlocksWith<CRC32CPolicy>(link, input, output, initiation);
+    }
+    if (initiation == NAK) {
+        return receiveBlocks<ChecksumPolicy>(link, input, output);
+    }
+    return receiveBlocksWith<CRC16Policy>(link, input, output, initiation);
+}
+
+// Rozszerzenia protokołu uzgadniamy przed znakiem inicjującym: nadawca, który je zna, odpowiada
+// ACK albo NAK, a stary nadawca pomija prośbę i po timeoucie przesyłamy plik po staremu
+bool sendRequest(Transport& link, ReceiveBuffer& input, std::span<const uint8_t> request) {
+    for (int i = 0; i < 3; ++i) {
+        writeAll(link, request);
+
+        if (input.fillTo(1, Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT))) {
+            // odpowiedzi na powtórzone prośby nie mogą zostać wzięte za początek pierwszej ramki
+            uint8_t response = input[0];
+            purgeInput(link, input);
+            return response == ACK;
+        }
+    }
+    return false;
+}
+
+// Liczby w prośbie o wznowienie idą cyframi szesnastkowymi zapisanymi literami od 'a' do 'p'. Żadna z nich
+// nie jest znakiem sterującym ani inicjującym (zwykłe cyfry zawierają '3', czyli prośbę o CRC-32C),
+// więc nadawca, który prośby nie zrozumie albo nie dostanie jej w całości, tylko ją pominie.
+void encodeResumeField(uint64_t value, std::span<char> digits) {
+    for (size_t i = digits.size(); i-- > 0; value >>= 4) {
+        digits[i] = static_cast<char>('a' + (value & 0xF));
+    }
+}
+
+bool decodeResumeField(std::span<const char> digits, uint64_t& value) {
+    value = 0;
+    for (char digit : digits) {
+        if (digit < 'a' || digit > 'p') {
+            return false;
+        }
+        value = (value << 4) | static_cast<uint64_t>(digit - 'a');
+    }
+    return true;
+}
+
+// Prosi nadawcę o pominięcie odebranych już bloków
+bool requestResume(Transport& link, ReceiveBuffer& input, const Checkpoint& checkpoint) {
+    std::array<char, RESUME_REQUEST_SIZE> request;
+    request[0] = static_cast<char>(RESUME);
+    encodeResumeField(checkpoint.bytes, std::span(request).subspan(1, 16));
+    encodeResumeField(checkpoint.lastLength, std::span(request).subspan(17, 4));
+    encodeResumeField(checkpoint.lastCRC, std::span(request).subspan(21, 4));
+    return sendRequest(link, input, std::span(reinterpret_cast<const uint8_t*>(request.data()), request.size()));
+}
+
+bool requestCRC32C(Transport& link, ReceiveBuffer& input) {
+    uint8_t request = CRC32C_REQUEST;
+    return sendRequest(link, input, std::span(&request, 1));
+}
+
+bool receiveFile(Transport& link, const std::string& path, const TransferOptions& options) {
+    ReceiveBuffer input(link);
+    uint8_t initiation = initiationByte(options);
+
+    bool crc32 = options.crc32 && requestCRC32C(link, input);
+
+    if (!options.resume) {
+        OutputFile output(path, options);
+        bool received = startTransfer(link, input, initiation) && receiveData(link, input, output, initiation, crc32);
+        return output.finish(received);
+    }
+
+    // nadawca zaczyna numerację znów od 1, ale od bajtu checkpoint.bytes swojego pliku
+    Checkpoint checkpoint;
+    if (loadCheckpoint(path, checkpoint) && truncateToCheckpoint(path, checkpoint)
+        && requestResume(link, input, checkpoint)) {
+        std::cout << "Wznawianie od bloku " << checkpoint.blocks + 1 << std::endl;
+    } else {
+        checkpoint = Checkpoint();
+    }
+
+    OutputFile output(path, checkpoint, options);
+    bool received = startTransfer(link, input, initiation) && receiveData(link, input, output, initiation, crc32);
+    return output.finish(received);
+}
+
+bool receiveHeaderBlock(Transport& link, ReceiveBuffer& input, std::span<uint8_t> header) {
+    for (int errors = 0; errors < MAX_RETRIES; ++errors) {
+        Frame frame = receiveFrame<CRC16Policy>(input, header);
+        if (frame.status == FrameStatus::Block && frame.checkValid && frame.blockNumber == 0) {
+            return true;
+        }
+        if (frame.status == FrameStatus::Cancel) {
+            return false;
+        }
+        if (frame.status == FrameStatus::Corrupted) {
+            purgeInput(link, input);
+        }
+        writeByte(link, NAK);
+    }
+    return false;
+}
+
+bool receiveBatch(Transport& link, const std::string& directory, const TransferOptions& options) {
+    ReceiveBuffer input(link);
+    std::array<uint8_t, BLOCK_SIZE_1K + 1> header{};
+    // YMODEM zawsze używa CRC
+    uint8_t initiation = initiationByte(options) == NAK ? C : initiationByte(options);
+
+    while (true) {
+        // blok 0 zwykle ma 128 bajtów, a za nim nie mogą zostać bajty opisu poprzedniego pliku
+        header.fill(0);
+        if (!startTransfer(link, input, initiation)
+            || !receiveHeaderBlock(link, input, std::span(header.data(), BLOCK_SIZE_1K))) {
+            return false;
+        }
+
+        std::string name(reinterpret_cast<const char*>(header.data()));
+        if (name.empty()) {
+            writeByte(link, ACK);
+            return true;
+        }
+
+        // z nazwy bierzemy tylko ostatni człon, żeby nadawca nie mógł pisać poza wskazanym katalogiem
+        std::filesystem::path fileName = std::filesystem::path(name).filename();
+        if (fileName.empty() || fileName == "." || fileName == "..") {
+            cancelTransfer(link);
+            return false;
+        }
+        std::filesystem::path path = std::filesystem::path(directory) / fileName;
+
+        uint64_t length = 0;
+        long long modified = 0;
+        std::istringstream info(reinterpret_cast<const char*>(header.data()) + name.size() + 1);
+        bool hasLength = static_cast<bool>(info >> length);
+        bool hasModified = hasLength && static_cast<bool>(info >> std::oct >> modified);
+
+        OutputFile output(path.string(), options);
+        if (hasLength) {
+            output.setLength(length);
+        }
+        writeByte(link, ACK);
+
+        bool crc32 = options.crc32 && requestCRC32C(link, input);
+        bool received = startTransfer(link, input, initiation) && receiveData(link, input, output, initiation, crc32);
+        if (!output.finish(received)) {
+            return false;
+        }
+
+        if (hasModified && modified > 0) {
+            std::error_code error;
+            auto time = std::chrono::file_clock::from_sys(std::chrono::sys_seconds(std::chrono::seconds(modified)));
+            std::filesystem::last_write_time(path, time, error);
+        }
+        std::cout << "Odebrano " << path.string() << std::endl;
+    }
+}
+
+// Fragmenty odebrane przy przesyłaniu jednego pliku przez kilka łączy. Każde łącze zapisuje swoje
+// fragmenty wprost w pliku wyjściowym, a tu zostaje tylko ich spis, z którego na koniec wynika,
+// czy plik jest kompletny. Fragment powtórzony po zerwaniu łącza może się pojawić dwa razy.
+class StripeManifest {
+public:
+    // Wszystkie fragmenty muszą opisywać plik tej samej długości
+    bool expect(uint64_t total) {
+        std::lock_guard lock(mutex);
+        if (size && *size != total) {
+            return false;
+        }
+        size = total;
+        return true;
+    }
+
+    // Łącze zaczyna odbierać fragment; ended() po jego odebraniu albo zerwaniu
+    void started() {
+        std::lock_guard lock(mutex);
+        receiving++;
+    }
+
+    void ended(uint64_t offset, uint64_t length, bool received) {
+        std::lock_guard lock(mutex);
+        receiving--;
+        if (received) {
+            uint64_t& stored = stripes[offset];
+            stored = std::max(stored, length);
+        }
+    }
+
+    // Czy któreś łącze jest w trakcie fragmentu, który po zerwaniu nadawca może przysłać innym łączem
+    bool busy() {
+        std::lock_guard lock(mutex);
+        return receiving > 0;
+    }
+
+    // Długość pliku albo nic, jeśli nie przyszedł żaden fragment
+    std::optional<uint64_t> total() {
+        std::lock_guard lock(mutex);
+        return size;
+    }
+
+    bool complete() {
+        std::lock_guard lock(mutex);
+        uint64_t covered = 0;
+        for (auto [offset, length] : stripes) {
+            if (offset > covered) {
+                return false;
+            }
+            covered = std::max(covered, offset + length);
+        }
+        return size && covered >= *size;
+    }
+
+private:
+    std::mutex mutex;
+    std::optional<uint64_t> size;
+    std::map<uint64_t, uint64_t> stripes;
+    size_t receiving = 0;
+};
+
+// Czeka na blok 0 kolejnego fragmentu. Bezczynne łącze nie może się poddać, dopóki inne łącze odbiera
+// fragment, bo po jego zerwaniu nadawca przyśle ten fragment tutaj. Gdy nikt nic nie odbiera, a plik
+// jest niekompletny, czekamy jeszcze jedną rundę na fragment zwrócony do kolejki nadawcy.
+bool startStripe(Transport& link, ReceiveBuffer& input, uint8_t initiation, StripeManifest& manifest) {
+    bool lastRound = false;
+    while (!startTransfer(link, input, initiation)) {
+        if (!manifest.busy()) {
+            if (lastRound || manifest.complete()) {
+                return false;
+            }
+            lastRound = true;
+        }
+    }
+    return true;
+}
+
+// Jedno łącze odbioru na kilku łączach: sesja YMODEM, w której zamiast plików przychodzą fragmenty,
+// a blok 0 zawiera "długość_pliku przesunięcie długość_fragmentu". true, gdy nadawca zakończył sesję.
+bool receiveStripes(Transport& link, const std::string& path, const TransferOptions& options,
+                    StripeManifest& manifest) {
+    ReceiveBuffer input(link);
+    std::array<uint8_t, BLOCK_SIZE_1K + 1> header{};
+    uint8_t initiation = initiationByte(options) == NAK ? C : initiationByte(options);
+    // plik zapisujemy na dysk raz, po odebraniu wszystkich fragmentów
+    TransferOptions stripeOptions = options;
+    stripeOptions.sync = false;
+
+    while (true) {
+        header.fill(0);
+        if (!startStripe(link, input, initiation, manifest)
+            || !receiveHeaderBlock(link, input, std::span(header.data(), BLOCK_SIZE_1K))) {
+            return false;
+        }
+
+        std::string_view name(reinterpret_cast<const char*>(header.data()));
+        if (name.empty()) {
+            writeByte(link, ACK);
+            return true;
+        }
+
+        // "długość_pliku przesunięcie długość_fragmentu" bez strumienia - fragment nie alokuje na opis
+        uint64_t total = 0;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        const char* text = name.data() + name.size() + 1;
+        const char* textEnd = reinterpret_cast<const char*>(header.data()) + BLOCK_SIZE_1K;
+        bool parsed = true;
+        for (uint64_t* value : {&total, &offset, &length}) {
+            while (text < textEnd && *text == ' ') {
+                text++;
+            }
+            auto [next, error] = std::from_chars(text, textEnd, *value);
+            parsed = parsed && error == std::errc();
+            text = next;
+        }
+        if (!parsed || length == 0 || length > total || offset > total - length
+            || !manifest.expect(total)) {
+            cancelTransfer(link);
+            return false;
+        }
+
+        OutputFile output(path, offset, length, stripeOptions);
+        manifest.started();
+        writeByte(link, ACK);
+
+        bool crc32 = options.crc32 && requestCRC32C(link, input);
+        bool received = startTransfer(link, input, initiation) && receiveData(link, input, output, initiation, crc32);
+        received = output.finish(received);
+        manifest.ended(offset, length, received);
+        if (!received) {
+            return false;
+        }
+    }
+}
+
+bool receiveStriped(const std::vector<Transport*>& links, const std::string& path, const TransferOptions& options) {
+    if (links.empty() || !std::ofstream(path, std::ios::binary | std::ios::trunc)) {
+        return false;
+    }
+
+    StripeManifest manifest;
+    std::atomic<bool> ended{false};
+    std::vector<std::thread> workers;
+    for (Transport* link : links) {
+        workers.emplace_back([&, link] {
+            if (receiveStripes(*link, path, options, manifest)) {
+                ended = true;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // bez żadnego fragmentu plik jest pusty, o ile nadawca poprawnie zakończył sesję
+    std::optional<uint64_t> total = manifest.total();
+    if (total ? !manifest.complete() : !ended) {
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::resize_file(path, total.value_or(0), error);
+    return !error && (!options.sync || syncFile(path));
+}
+
+// Plik źródłowy nadawcy. Zwykły plik jest odwzorowany w pamięć i bloki wskazują wprost na
+// odwzorowanie; to, czego nie da się zmapować (pusty plik, potok), czytamy strumieniem do bufora.
+class InputFile {
+public:
+    bool open(const std::string& path) {
+        if (mapping.open(path)) {
+            return true;
+        }
+        stream.open(path, std::ios::binary);
+        return static_cast<bool>(stream);
+    }
+
+    // Następny blok danych - w odwzorowaniu albo w buffer, jeśli trzeba go było przeczytać lub dopełnić
+    bool nextBlock(size_t maxBlockSize, std::vector<uint8_t>& buffer, std::span<const uint8_t>& block) {
+        std::span<const uint8_t> data = read(maxBlockSize, buffer);
+        if (data.empty()) {
+            return false;
+        }
+
+        size_t blockSize = blockSizeForData(data.size(), maxBlockSize);
+        if (data.size() < blockSize) {
+            if (data.data() != buffer.data()) {
+                buffer.assign(data.begin(), data.end());
+            } else {
+                buffer.resize(data.size());
+            }
+            buffer.resize(blockSize, 0x1A);
+            data = buffer;
+        }
+        block = data;
+        return true;
+    }
+
+    std::span<const uint8_t> readAt(uint64_t offset, size_t length, std::vector<uint8_t>& buffer) {
+        seek(offset);
+        return read(length, buffer);
+    }
+
+    void seek(uint64_t offset) {
+        position = offset;
+        if (mapping.data().empty()) {
+            stream.clear();
+            stream.seekg(static_cast<std::streamoff>(offset));
+        }
+    }
+
+    // Ogranicza odczyt do fragmentu pliku - nextBlock kończy dane na jego końcu
+    void limit(uint64_t offset, uint64_t length) {
+        seek(offset);
+        end = offset + length;
+    }
+
+private:
+    std::span<const uint8_t> read(size_t length, std::vector<uint8_t>& buffer) {
+        length = static_cast<size_t>(std::min<uint64_t>(length, end > position ? end - position : 0));
+        std::span<const uint8_t> mapped = mapping.data();
+        if (!mapped.empty()) {
+            size_t offset = static_cast<size_t>(std::min<uint64_t>(position, mapped.size()));
+            std::span<const uint8_t> data = mapped.subspan(offset, std::min(length, mapped.size() - offset));
+            position += data.size();
+            return data;
+        }
+
+        buffer.resize(length);
+        stream.read(reinterpret_cast<char*>(buffer.data()), length);
+        size_t bytesRead = stream.gcount();
+        position += bytesRead;
+        return std::span(buffer).first(bytesRead);
+    }
+
+    MappedFile mapping;
+    std::ifstream stream;
+    uint64_t position = 0;
+    uint64_t end = UINT64_MAX;
+};
+
+// Wątek czytający plik z wyprzedzeniem: czyta bloki i składa z nich gotowe ramki, więc nadawca
+// nie czeka na dysk między blokami. Ramki są zwalniane dopiero wtedy, gdy nie będą już powtarzane,
+// dlatego pierścień mieści całe okno i READ_AHEAD_BLOCKS ramek w przód.
+template <typename Policy>
+class PacketReader {
+public:
+    PacketReader(InputFile& file, size_t maxBlockSize, size_t inFlight) : ring(inFlight + READ_AHEAD_BLOCKS) {
+        worker = std::thread([this, &file, maxBlockSize] {
+            produce(file, maxBlockSize);
+        });
+    }
+
+    PacketReader(const PacketReader&) = delete;
+    PacketReader& operator=(const PacketReader&) = delete;
+
+    ~PacketReader() {
+        ring.cancel();
+        worker.join();
+    }
+
+    // Następna ramka albo nullptr na końcu pliku; ważna do odpowiadającego jej release()
+    const Packet* next() {
+        Slot* slot = ring.take();
+        return slot && !slot->packet.block.empty() ? &slot->packet : nullptr;
+    }
+
+    void release() {
+        ring.release();
+    }
+
+private:
+    struct Slot {
+        std::vector<uint8_t> buffer;
+        Packet packet;
+    };
+
+    void produce(InputFile& file, size_t maxBlockSize) {
+        uint8_t blockNumber = 1;
+
+        while (Slot* slot = ring.claim()) {
+            // koniec pliku to ramka z pustym blokiem
+            std::span<const uint8_t> block;
+            bool more = file.nextBlock(maxBlockSize, slot->buffer, block);
+            if (more) {
+                buildPacket<Policy>(blockNumber++, block, slot->packet);
+            } else {
+                slot->packet.block = {};
+            }
+            ring.publish();
+            if (!more) {
+                return;
+            }
+        }
+    }
+
+    SpscRing<Slot> ring;
+    std::thread worker;
+};
+
+struct WindowSlot {
+    uint8_t blockNumber;
+    const Packet* packet;
+    bool acked;
+    int retries;
+};
+
+template <typename Policy>
+bool sendBlocksWindowed(Transport& link, PacketReader<Policy>& reader, int windowSize) {
+    // okno to pierścień windowSize slotów wskazujących na ramki z wątku czytającego
+    std::vector<WindowSlot> slots(windowSize);
+    size_t first = 0;
+    size_t inFlight = 0;
+    auto window = [&](size_t offset) -> WindowSlot& {
+        return slots[(first + offset) % slots.size()];
+    };
+
+    uint8_t nextBlock = 1;
+    bool endOfFile = false;
+
+    while (true) {
+        while (!endOfFile && inFlight < slots.size()) {
+            const Packet* packet = reader.next();
+            if (!packet) {
+                endOfFile = true;
+                break;
+            }
+            WindowSlot& slot = window(inFlight++);
+            slot.blockNumber = nextBlock++;
+            slot.packet = packet;
+            slot.acked = false;
+            slot.retries = 0;
+            // martwe łącze kończy transmisję od razu, a nie po MAX_RETRIES timeoutach
+            if (!writePacket(link, *packet)) {
+                return false;
+            }
+        }
+
+        if (inFlight == 0) {
+            break;
+        }
+
+        uint8_t response;
+        uint8_t blockNumber;
+        int result = readWindowReply(link, response, blockNumber);
+        if (result < 0) {
+            // brak odpowiedzi - powtarzamy wszystkie niepotwierdzone bloki z okna
+            for (size_t i = 0; i < inFlight; ++i) {
+                WindowSlot& slot = window(i);
+                if (slot.acked) {
+                    continue;
+                }
+                if (++slot.retries >= MAX_RETRIES || !writePacket(link, *slot.packet)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        if (response == CAN) {
+            return false;
+        }
+        if (result != 3) {
+            continue;
+        }
+
+        uint8_t offset = blockNumber - window(0).blockNumber;
+        if (offset >= inFlight) {
+            continue;
+        }
+
+        WindowSlot& slot = window(offset);
+        if (response == ACK) {
+            slot.acked = true;
+            while (inFlight > 0 && window(0).acked) {
+                first = (first + 1) % slots.size();
+                inFlight--;
+                reader.release();
+            }
+        } else if (!slot.acked) {
+            if (++slot.retries >= MAX_RETRIES || !writePacket(link, *slot.packet)) {
+                return false;
+            }
+        }
+    }
+
+    // EOT potwierdzany jest numerem pierwszego niewysłanego bloku, żeby nie pomylić go ze spóźnionym ACK
+    for (int retries = 0; retries < MAX_RETRIES; ++retries) {
+        if (writeByte(link, EOT) < 0) {
+            return false;
+        }
+
+        uint8_t response;
+        uint8_t blockNumber;
+        if (readWindowReply(link, response, blockNumber) == 3 && response == ACK && blockNumber == nextBlock) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool sendEndOfTransmission(Transport& link) {
+    for (int retries = 0; retries < MAX_RETRIES; ++retries) {
+        writeByte(link, EOT);
+
+        uint8_t response;
+        if (readByteWithTimeout(link, response) > 0 && response == ACK) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Policy>
+bool sendBlocksStreaming(Transport& link, PacketReader<Policy>& reader) {
+    while (const Packet* packet = reader.next()) {
+        if (!writePacket(link, *packet)) {
+            return false;
+        }
+        reader.release();
+
+        // odbiorca odzywa się w trakcie tylko po to, żeby przerwać transmisję
+        uint8_t response;
+        if (link.read(&response, 1, Transport::Clock::now()) > 0 && response == CAN) {
+            return false;
+        }
+    }
+
+    return sendEndOfTransmission(link);
+}
+
+// Odpowiada na prośbę o wznowienie: ACK i plik ustawiony za pominiętymi blokami, jeśli mamy na tej
+// pozycji blok o tym samym CRC co odbiorca, w przeciwnym razie NAK i wysyłanie od początku. Bez pliku
+// (YMODEM, fragmenty) prośbę i tak czytamy do końca i odmawiamy.
+void answerResumeRequest(Transport& link, InputFile* file) {
+    std::array<char, RESUME_REQUEST_SIZE - 1> request;
+    if (readWithTimeout(link, std::span(reinterpret_cast<uint8_t*>(request.data()), request.size()))
+        != static_cast<int>(request.size())) {
+        return;
+    }
+
+    uint64_t offset = 0;
+    uint64_t lastLength = 0;
+    uint64_t lastCRC = 0;
+    std::span<const char> text(request);
+    bool parsed = decodeResumeField(text.subspan(0, 16), offset)
+        && decodeResumeField(text.subspan(16, 4), lastLength)
+        && decodeResumeField(text.subspan(20, 4), lastCRC);
+
+    std::vector<uint8_t> buffer;
+    bool matches = false;
+    if (file && parsed && lastLength > 0 && lastLength <= BLOCK_SIZE_1K && lastLength <= offset) {
+        std::span<const uint8_t> last = file->readAt(offset - lastLength, static_cast<size_t>(lastLength), buffer);
+        matches = last.size() == lastLength && calculateCRC16(last) == lastCRC;
+    }
+    if (file) {
+        file->seek(matches ? offset : 0);
+    }
+    writeByte(link, matches ? ACK : NAK);
+}
+
+// Czeka na znak, którym odbiorca rozpoczyna transmisję; zwraca go albo -1. Po drodze przyjmuje
+// prośbę o CRC-32C, a z podanym plikiem także prośby o wznowienie.
+int waitForInitiation(Transport& link, const TransferOptions& options, bool& crc32, InputFile* file = nullptr) {
+    int retries = 0;
+    crc32 = false;
+
+    while (retries < MAX_RETRIES) {
+        uint8_t response;
+        if (readByteWithTimeout(link, response) > 0) {
+            if (response == NAK || response == C || response == G || (response == W && options.windowSize > 0)) {
+                return response;
+            }
+            if (response == RESUME) {
+                answerResumeRequest(link, file);
+                continue;
+            }
+            if (response == CRC32C_REQUEST) {
+                crc32 = true;
+                writeByte(link, ACK);
+                continue;
+            }
+            if (response == CAN) {
+                return -1;
+            }
+        } else {
+            retries++;
+        }
+    }
+    return -1;
+}
+
+bool sendPacketAcked(Transport& link, const Packet& packet) {
+    for (int retries = 0; retries < MAX_RETRIES; ++retries) {
+        writePacket(link, packet);
+
+        uint8_t response;
+        if (readByteWithTimeout(link, response) > 0) {
+            if (response == ACK) {
+                return true;
+            } else if (response == CAN) {
+                return false;
+            }
+        }
+    }
+    return false;
+}
+
+// Zwykły XMODEM to ta sama maszyna stanów co w demonie; znak inicjujący odebrało już waitForInitiation.
+// Ramki idą z wątku czytającego, a ramkę zwalniamy dopiero, gdy maszyna po ACK prosi o następną.
+template <typename Policy>
+bool sendBlocks(Transport& link, PacketReader<Policy>& reader) {
+    bool held = false;
+    XmodemSender<Policy> sender([&reader, &held]() -> const Packet* {
+        if (held) {
+            reader.release();
+        }
+        const Packet* packet = reader.next();
+        held = packet != nullptr;
+        return packet;
+    }, true);
+    ReceiveBuffer input(link, 1);
+    sender.start(Transport::Clock::now());
+    return runMachine(link, input, sender);
+}
+
+template <typename Policy>
+bool sendBlocksWith(Transport& link, InputFile& file, int initiation, size_t maxBlockSize, int windowSize) {
+    PacketReader<Policy> reader(file, maxBlockSize, initiation == W ? windowSize : 1);
+    switch (initiation) {
+        case W:
+            return sendBlocksWindowed<Policy>(link, reader, windowSize);
+        case G:
+            return sendBlocksStreaming<Policy>(link, reader);
+        default:
+            return sendBlocks<Policy>(link, reader);
+    }
+}
+
+bool sendData(Transport& link, InputFile& file, int initiation, bool crc32, const TransferOptions& options) {
+    // XMODEM-1K wymaga CRC, przy sumie kontrolnej zostajemy przy blokach 128 bajtów
+    size_t maxBlockSize = (options.oneK && (initiation != NAK || crc32)) ? BLOCK_SIZE_1K : BLOCK_SIZE;
+
+    if (crc32) {
+        return sendBlocksWith<CRC32CPolicy>(link, file, initiation, maxBlockSize, options.windowSize);
+    }
+    if (initiation == NAK) {
+        return sendBlocksWith<ChecksumPolicy>(link, file, initiation, maxBlockSize, options.windowSize);
+    }
+    return sendBlocksWith<CRC16Policy>(link, file, initiation, maxBlockSize, options.windowSize);
+}
+
+bool sendFile(Transport& link, const std::string& path, const TransferOptions& options) {
+    InputFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    bool crc32;
+    int initiation = waitForInitiation(link, options, crc32, &file);
+    return initiation >= 0 && sendData(link, file, initiation, crc32, options);
+}
+
+// Dopełnia blok 0 zerami do 128 albo 1024 bajtów. Dłuższego opisu nie obcinamy, bo odbiornik
+// dostałby uciętą nazwę albo długość - false i nadawca przerywa transmisję.
+bool padHeaderBlock(std::vector<uint8_t>& block) {
+    if (block.size() > BLOCK_SIZE_1K) {
+        return false;
+    }
+    block.resize(block.size() < BLOCK_SIZE ? BLOCK_SIZE : BLOCK_SIZE_1K, 0);
+    return true;
+}
+
+// Blok 0 YMODEM: nazwa pliku zakończona zerem, a po niej "długość czas_modyfikacji" - długość
+// dziesiętnie, czas w sekundach od 1970 ósemkowo. Pusta nazwa kończy sesję.
+bool buildHeaderBlock(const std::filesystem::path& path, std::vector<uint8_t>& block) {
+    block.clear();
+    if (!path.empty()) {
+        std::string name = path.filename().string();
+        auto modified = std::chrono::file_clock::to_sys(std::filesystem::last_write_time(path));
+        long long seconds = std::chrono::duration_cast<std::chrono::seconds>(modified.time_since_epoch()).count();
+
+        std::ostringstream info;
+        info << std::filesystem::file_size(path) << ' ' << std::oct << seconds;
+        block.insert(block.end(), name.begin(), name.end());
+        block.push_back(0);
+        std::string text = info.str();
+        block.insert(block.end(), text.begin(), text.end());
+    }
+    return padHeaderBlock(block);
+}
+
+bool sendBatch(Transport& link, const std::vector<std::string>& paths, const TransferOptions& options) {
+    bool crc32;
+
+    for (size_t i = 0; i <= paths.size(); ++i) {
+        std::filesystem::path path = i < paths.size() ? paths[i] : "";
+        InputFile file;
+        std::vector<uint8_t> header;
+        if ((!path.empty() && !file.open(path)) || !buildHeaderBlock(path, header)) {
+            cancelTransfer(link);
+            return false;
+        }
+
+        if (waitForInitiation(link, options, crc32) < 0) {
+            return false;
+        }
+        Packet packet;
+        buildPacket<CRC16Policy>(0, header, packet);
+        if (!sendPacketAcked(link, packet)) {
+            return false;
+        }
+        if (path.empty()) {
+            return true;
+        }
+
+        int initiation = waitForInitiation(link, options, crc32);
+        if (initiation < 0 || !sendData(link, file, initiation, crc32, options)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Stripe {
+    uint64_t offset;
+    uint64_t length;
+};
+
+// Fragmenty pliku rozdawane łączom po kolei, więc szybsze łącze bierze ich więcej. Fragment z
+// zerwanego łącza wraca do kolejki i przejmuje go inne łącze, dlatego łącze kończy sesję dopiero
+// wtedy, gdy kolejka jest pusta i żaden fragment nie jest już w drodze.
+class StripeQueue {
+public:
+    StripeQueue(uint64_t size, uint64_t stripeSize) : size(size), stripeSize(stripeSize) {
+    }
+
+    // false, gdy nie ma już nic do wysłania
+    bool take(Stripe& stripe) {
+        std::unique_lock lock(mutex);
+        changed.wait(lock, [this] {
+            return !returned.empty() || next < size || inFlight == 0;
+        });
+        if (!returned.empty()) {
+            stripe = returned.back();
+            returned.pop_back();
+        } else if (next < size) {
+            stripe = {next, std::min(stripeSize, size - next)};
+            next += stripe.length;
+        } else {
+            return false;
+        }
+        inFlight++;
+        return true;
+    }
+
+    void done() {
+        std::lock_guard lock(mutex);
+        inFlight--;
+        changed.notify_all();
+    }
+
+    void failed(const Stripe& stripe) {
+        std::lock_guard lock(mutex);
+        returned.push_back(stripe);
+        inFlight--;
+        changed.notify_all();
+    }
+
+    bool complete() {
+        std::lock_guard lock(mutex);
+        return next >= size && returned.empty() && inFlight == 0;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint64_t size;
+    uint64_t stripeSize;
+    uint64_t next = 0;
+    std::vector<Stripe> returned;
+    size_t inFlight = 0;
+};
+
+// Liczby piszemy przez to_chars, a nie strumieniem, żeby liczba alokacji nie zależała od ich długości
+bool buildStripeHeader(const std::string& name, uint64_t total, const Stripe& stripe, std::vector<uint8_t>& block) {
+    char text[64];
+    char* end = text;
+    for (uint64_t value : {total, stripe.offset, stripe.length}) {
+        end = std::to_chars(end, std::end(text), value).ptr;
+        *end++ = ' ';
+    }
+
+    block.reserve(BLOCK_SIZE_1K);
+    block.assign(name.begin(), name.end());
+    block.push_back(0);
+    block.insert(block.end(), text, end - 1);
+    return padHeaderBlock(block);
+}
+
+// Odrzuca to, co już czeka na łączu, bez czekania na ciszę jak purgeInput
+void dropInput(Transport& link) {
+    uint8_t scratch[256];
+
+    while (link.read(scratch, sizeof(scratch), Transport::Clock::now()) > 0) {
+    }
+}
+
+// Blok 0 z miejscem fragmentu w pliku, a po nim dane fragmentu jak zwykły plik w sesji YMODEM
+bool sendStripe(Transport& link, InputFile& file, const std::string& name, uint64_t total, const Stripe& stripe,
+                const TransferOptions& options) {
+    std::vector<uint8_t> header;
+    if (!buildStripeHeader(name, total, stripe, header)) {
+        return false;
+    }
+    Packet packet;
+    buildPacket<CRC16Policy>(0, header, packet);
+    bool crc32;
+    if (waitForInitiation(link, options, crc32) < 0 || !sendPacketAcked(link, packet)) {
+        return false;
+    }
+
+    file.limit(stripe.offset, stripe.length);
+    int initiation = waitForInitiation(link, options, crc32);
+    return initiation >= 0 && sendData(link, file, initiation, crc32, options);
+}
+
+// Jedno łącze wysyłania na kilku łączach: bierze fragmenty z kolejki, dopóki jakieś zostały
+void sendStripes(Transport& link, const std::string& path, uint64_t total, const TransferOptions& options,
+                 StripeQueue& queue) {
+    InputFile file;
+    if (!file.open(path)) {
+        cancelTransfer(link);
+        return;
+    }
+    std::string name = std::filesystem::path(path).filename().string();
+
+    Stripe stripe;
+    while (true) {
+        auto waitStart = Transport::Clock::now();
+        bool more = queue.take(stripe);
+        // przy długim czekaniu odbiornik co TIMEOUT ponawiał znak inicjujący, a stare znaki wzięlibyśmy
+        // za odpowiedzi na ramki; następny przyjdzie najpóźniej po TIMEOUT
+        if (Transport::Clock::now() - waitStart >= std::chrono::milliseconds(TIMEOUT)) {
+            dropInput(link);
+        }
+        if (!more) {
+            break;
+        }
+        if (!sendStripe(link, file, name, total, stripe, options)) {
+            queue.failed(stripe);
+            return;
+        }
+        queue.done();
+    }
+
+    // pusty blok 0 kończy sesję na tym łączu
+    std::vector<uint8_t> header;
+    buildHeaderBlock("", header);
+    Packet packet;
+    buildPacket<CRC16Policy>(0, header, packet);
+    bool crc32;
+    if (waitForInitiation(link, options, crc32) >= 0) {
+        sendPacketAcked(link, packet);
+    }
+}
+
+// Fragmenty są wielokrotnością bloku 1K, więc dopełniany jest tylko ostatni blok pliku. Przy małym
+// pliku fragmenty są mniejsze, żeby każde łącze dostało choć jeden.
+uint64_t stripeSizeFor(uint64_t size, size_t links) {
+    uint64_t perLink = (size + links - 1) / links;
+    uint64_t stripeSize = (perLink + BLOCK_SIZE_1K - 1) / BLOCK_SIZE_1K * BLOCK_SIZE_1K;
+    return std::clamp<uint64_t>(stripeSize, BLOCK_SIZE_1K, STRIPE_SIZE);
+}
+
+bool sendStriped(const std::vector<Transport*>& links, const std::string& path, const TransferOptions& options) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (error || links.empty()) {
+        return false;
+    }
+    // nagłówek z największymi możliwymi liczbami musi się zmieścić w bloku 0, zanim rozdamy fragmenty
+    std::vector<uint8_t> header;
+    if (!buildStripeHeader(std::filesystem::path(path).filename().string(), size, {size, size}, header)) {
+        return false;
+    }
+    StripeQueue queue(size, stripeSizeFor(size, links.size()));
+
+    std::vector<std::thread> workers;
+    for (Transport* link : links) {
+        workers.emplace_back([&, link] {
+            sendStripes(*link, path, size, options, queue);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return queue.complete();
+}
@@ -0,0 +1,50 @@
+#ifndef XMODEM_H
+#define XMODEM_H
+
+#include <string>
+#include <vector>
+
+#include "transport.h"
+
+#define BLOCK_SIZE 128
+#define BLOCK_SIZE_1K 1024
+#define MAX_RETRIES 10
+#define WINDOW_MAX 64
+
+#define TIMEOUT 10000
+#define TIMEOUT_PER_BYTE 10
+#define PURGE_TIMEOUT 100
+
+// Ustawienia jednej transmisji. Nie ma stanu globalnego, więc kilka transmisji może iść równolegle.
+struct TransferOptions {
+    bool crc = false;
+    bool oneK = false;
+    bool streaming = false;
+    int windowSize = 0;
+    // końcówka ramek CRC-32C zamiast CRC16, uzgadniana z nadawcą przed znakiem inicjującym
+    bool crc32 = false;
+    // odbiornik zapisuje checkpoint obok pliku i po przerwaniu wznawia od ostatniego zapisanego bloku
+    bool resume = false;
+    // po odbiorze plik jest zapisywany na dysk (fsync), zanim odbiornik zgłosi sukces
+    bool sync = false;
+    // odbiornik trzyma ostatni blok do EOT i obcina z niego dopełnienie 0x1A; bez tej opcji plik
+    // zachowuje dopełnienie, chyba że nadawca podał długość (YMODEM)
+    bool trimPadding = false;
+};
+
+bool receiveFile(Transport& link, const std::string& path, const TransferOptions& options);
+bool sendFile(Transport& link, const std::string& path, const TransferOptions& options);
+
+// YMODEM: wiele plików w jednej sesji, przed każdym blok 0 z nazwą, długością i czasem modyfikacji
+bool receiveBatch(Transport& link, const std::string& directory, const TransferOptions& options);
+bool sendBatch(Transport& link, const std::vector<std::string>& paths, const TransferOptions& options);
+
+// Jeden plik na kilku łączach naraz. Nadawca dzieli plik na fragmenty i rozdaje je łączom, na każdym
+// jak pliki w sesji YMODEM z blokiem 0 opisującym miejsce fragmentu w pliku; odbiornik zapisuje
+// fragmenty na ich miejsca i sprawdza, czy pokryły cały plik. Fragment z zerwanego łącza przejmuje inne.
+bool receiveStriped(const std::vector<Transport*>& links, const std::string& path, const TransferOptions& options);
+bool sendStriped(const std::vector<Transport*>& links, const std::string& path, const TransferOptions& options);
+// Rozmiar fragmentu, na jakie sendStriped dzieli plik o długości size
+uint64_t stripeSizeFor(uint64_t size, size_t links);
+
+#endif
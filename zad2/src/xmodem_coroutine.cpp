@@ -0,0 +1,44 @@
+#include <array>
+#include <memory>
+#include <utility>
+
+#include "xmodem_coroutine.h"
+
+// Korutyna napędzająca maszynę protokołu - odpowiednik blokującego runMachine z xmodem.cpp. Sesja
+// kończy się razem z maszyną, więc bajty można podawać jej całymi odczytami.
+static Task<bool> runMachine(AsyncTransport& link, ProtocolMachine& machine) {
+    std::array<uint8_t, 256> buffer;
+
+    machine.start(link.now());
+    while (true) {
+        std::vector<uint8_t>& output = machine.output();
+        if (!output.empty()) {
+            if (co_await link.write(output) < 0) {
+                machine.abort();
+            }
+            output.clear();
+        }
+        if (machine.finished()) {
+            co_return machine.succeeded();
+        }
+
+        int result = co_await link.read(buffer, machine.deadline());
+        if (result < 0) {
+            machine.abort();
+        } else if (result == 0) {
+            machine.poll(link.now());
+        } else {
+            machine.feed(std::span(buffer).first(result), link.now());
+        }
+    }
+}
+
+Task<bool> receiveXmodem(AsyncTransport& link, TransferOptions options, BlockSink sink) {
+    std::unique_ptr<ProtocolMachine> receiver = makeXmodemReceiver(options, std::move(sink));
+    co_return co_await runMachine(link, *receiver);
+}
+
+Task<bool> sendXmodem(AsyncTransport& link, TransferOptions options, BlockSource source) {
+    NegotiatingXmodemSender sender(options, std::move(source));
+    co_return co_await runMachine(link, sender);
+}
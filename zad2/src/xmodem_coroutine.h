@@ -0,0 +1,15 @@
+#ifndef XMODEM_COROUTINE_H
+#define XMODEM_COROUTINE_H
+
+#include "async_transport.h"
+#include "task.h"
+#include "xmodem.h"
+#include "xmodem_machine.h"
+
+// Zwykły XMODEM jako korutyny na AsyncTransport. Ramki i powtórzenia obsługują te same maszyny
+// XmodemReceiver i NegotiatingXmodemSender co w demonie i w receiveFile/sendFile; korutyna tylko
+// czeka przez co_await na dane albo termin maszyny.
+Task<bool> receiveXmodem(AsyncTransport& link, TransferOptions options, BlockSink sink);
+Task<bool> sendXmodem(AsyncTransport& link, TransferOptions options, BlockSource source);
+
+#endif
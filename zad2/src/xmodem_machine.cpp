@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <type_traits>
+#include <utility>
+
+#include "xmodem_machine.h"
+
+using namespace Control;
+
+#define START_ATTEMPTS 6
+
+using Clock = ProtocolMachine::Clock;
+
+static Clock::time_point after(Clock::time_point now, size_t bytes = 0) {
+    return now + std::chrono::milliseconds(TIMEOUT + TIMEOUT_PER_BYTE * bytes);
+}
+
+template <typename Policy>
+XmodemReceiver<Policy>::XmodemReceiver(BlockSink sink) : sink(std::move(sink)) {
+    partial.reserve(frameSizeFor(STX));
+}
+
+template <typename Policy>
+void XmodemReceiver<Policy>::start(Clock::time_point now) {
+    send(std::is_same_v<Policy, ChecksumPolicy> ? NAK : C);
+    attempts = 1;
+    arm(after(now));
+}
+
+template <typename Policy>
+void XmodemReceiver<Policy>::startReceiving(Clock::time_point now) {
+    state = State::Receiving;
+    arm(after(now));
+}
+
+template <typename Policy>
+void XmodemReceiver<Policy>::feed(std::span<const uint8_t> data, Clock::time_point now) {
+    if (finished()) {
+        return;
+    }
+    if (state == State::Purging) {
+        // śmieci po uszkodzonej ramce - czekamy na ciszę na łączu
+        arm(now + std::chrono::milliseconds(PURGE_TIMEOUT));
+        return;
+    }
+    state = State::Receiving;
+
+    while (!data.empty() && !finished() && state != State::Purging) {
+        if (!partial.empty()) {
+            size_t frameSize = frameSizeFor(partial[0]);
+            size_t count = std::min(data.size(), frameSize - partial.size());
+            partial.insert(partial.end(), data.begin(), data.begin() + count);
+            data = data.subspan(count);
+            if (partial.size() < frameSize) {
+                arm(after(now, frameSize));
+                return;
+            }
+            processFrame(partial, now);
+            partial.clear();
+            continue;
+        }
+
+        uint8_t headerByte = data[0];
+        if (headerByte == EOT) {
+            send(ACK);
+            finish(true);
+            return;
+        }
+        if (headerByte == CAN) {
+            finish(false);
+            return;
+        }
+        if (headerByte != SOH && headerByte != STX) {
+            corrupted(now);
+            return;
+        }
+
+        size_t frameSize = frameSizeFor(headerByte);
+        if (data.size() < frameSize) {
+            partial.assign(data.begin(), data.end());
+            arm(after(now, frameSize));
+            return;
+        }
+        processFrame(data.first(frameSize), now);
+        data = data.subspan(frameSize);
+    }
+}
+
+template <typename Policy>
+size_t XmodemReceiver<Policy>::frameLength(std::span<const uint8_t> data) const {
+    if (data.empty() || state == State::Purging) {
+        return data.size();
+    }
+    if (!partial.empty()) {
+        return std::min(data.size(), frameSizeFor(partial[0]) - partial.size());
+    }
+    if (data[0] != SOH && data[0] != STX) {
+        return 1;
+    }
+    return std::min(data.size(), frameSizeFor(data[0]));
+}
+
+template <typename Policy>
+void XmodemReceiver<Policy>::expired(Clock::time_point now) {
+    switch (state) {
+        case State::Starting:
+            if (attempts++ >= START_ATTEMPTS) {
+                finish(false);
+                return;
+            }
+            send(std::is_same_v<Policy, ChecksumPolicy> ? NAK : C);
+            arm(after(now));
+            break;
+        case State::Receiving:
+            // brak ramki to zwykły timeout, ramka niepełna - uszkodzona
+            if (partial.empty()) {
+                reject(now);
+            } else {
+                corrupted(now);
+            }
+            break;
+        case State::Purging:
+            state = State::Receiving;
+            reject(now);
+            break;
+    }
+}
+
+template <typename Policy>
+void XmodemReceiver<Policy>::processFrame(std::span<const uint8_t> frame, Clock::time_point now) {
+    if (frame[1] + frame[2] != 255) {
+        corrupted(now);
+        return;
+    }
+
+    uint8_t blockNumber = frame[1];
+    std::span<const uint8_t> block = frame.subspan(3, frame.size() - 3 - Policy::trailerSize);
+    if (!Policy::check(block, block.data() + block.size())) {
+        reject(now);
+        return;
+    }
+
+    errors = 0;
+    if (blockNumber == expectedBlock) {
+        if (!sink(block)) {
+            send(std::array<uint8_t, 2>{CAN, CAN});
+            finish(false);
+            return;
+        }
+        send(ACK);
+        expectedBlock++;
+    } else if (blockNumber == static_cast<uint8_t>(expectedBlock - 1)) {
+        send(ACK);
+    } else {
+        send(NAK);
+    }
+    arm(after(now));
+}
+
+// Uszkodzona ramka: odrzucamy wszystko, co przyszło, a NAK wysyłamy dopiero po ciszy na łączu
+template <typename Policy>
+void XmodemReceiver<Policy>::corrupted(Clock::time_point now) {
+    partial.clear();
+    state = State::Purging;
+    arm(now + std::chrono::milliseconds(PURGE_TIMEOUT));
+}
+
+template <typename Policy>
+void XmodemReceiver<Policy>::reject(Clock::time_point now) {
+    if (++errors >= MAX_RETRIES) {
+        finish(false);
+        return;
+    }
+    send(NAK);
+    arm(after(now));
+}
+
+template <typename Policy>
+XmodemSender<Policy>::XmodemSender(size_t maxBlockSize, BlockSource source)
+    : source([this] {
+          return readPacket();
+      }),
+      maxBlockSize(maxBlockSize), blocks(std::move(source)) {
+}
+
+template <typename Policy>
+XmodemSender<Policy>::XmodemSender(PacketSource source, bool gathered)
+    : source(std::move(source)), gathered(gathered) {
+}
+
+template <typename Policy>
+void XmodemSender<Policy>::start(Clock::time_point now) {
+    sendNextBlock(now);
+}
+
+template <typename Policy>
+void XmodemSender<Policy>::feed(std::span<const uint8_t> data, Clock::time_point now) {
+    for (uint8_t response : data) {
+        if (finished()) {
+            return;
+        }
+        if (response == CAN) {
+            finish(false);
+            return;
+        }
+
+        if (response == NAK) {
+            resend(now);
+        } else if (response == ACK) {
+            retries = 0;
+            if (state == State::EndOfTransmission) {
+                finish(true);
+            } else {
+                sendNextBlock(now);
+            }
+        }
+    }
+}
+
+template <typename Policy>
+void XmodemSender<Policy>::expired(Clock::time_point now) {
+    resend(now);
+}
+
+// Składa ramkę z następnych danych z BlockSource; krótki ostatni blok dopełnia 0x1A
+template <typename Policy>
+const Packet* XmodemSender<Policy>::readPacket() {
+    size_t bytesRead = blocks(std::span(block).first(maxBlockSize));
+    if (bytesRead == 0) {
+        return nullptr;
+    }
+
+    size_t blockSize = blockSizeForData(bytesRead, maxBlockSize);
+    std::fill(block.begin() + bytesRead, block.begin() + blockSize, 0x1A);
+    buildPacket<Policy>(blockNumber++, std::span(block).first(blockSize), ownPacket);
+    return &ownPacket;
+}
+
+template <typename Policy>
+void XmodemSender<Policy>::sendNextBlock(Clock::time_point now) {
+    packet = source();
+    if (!packet) {
+        state = State::EndOfTransmission;
+        send(EOT);
+        arm(after(now));
+        return;
+    }
+    sendFrame(now);
+}
+
+template <typename Policy>
+void XmodemSender<Policy>::sendFrame(Clock::time_point now) {
+    if (gathered) {
+        frame = packet;
+    } else {
+        send(packet->header);
+        send(packet->block);
+        send(std::span(packet->trailer).first(packet->trailerSize));
+    }
+    arm(after(now, packet->header.size() + packet->block.size() + packet->trailerSize));
+}
+
+template <typename Policy>
+void XmodemSender<Policy>::resend(Clock::time_point now) {
+    if (++retries >= MAX_RETRIES) {
+        finish(false);
+        return;
+    }
+    if (state == State::EndOfTransmission) {
+        send(EOT);
+        arm(after(now));
+    } else {
+        sendFrame(now);
+    }
+}
+
+template class XmodemReceiver<ChecksumPolicy>;
+template class XmodemReceiver<CRC16Policy>;
+template class XmodemReceiver<CRC32CPolicy>;
+template class XmodemSender<ChecksumPolicy>;
+template class XmodemSender<CRC16Policy>;
+template class XmodemSender<CRC32CPolicy>;
+
+NegotiatingXmodemSender::NegotiatingXmodemSender(const TransferOptions& options, BlockSource source)
+    : oneK(options.oneK), source(std::move(source)) {
+}
+
+void NegotiatingXmodemSender::start(Clock::time_point now) {
+    arm(after(now));
+}
+
+void NegotiatingXmodemSender::feed(std::span<const uint8_t> data, Clock::time_point now) {
+    if (finished()) {
+        return;
+    }
+    if (sender) {
+        sender->feed(data, now);
+        forward();
+        return;
+    }
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        if (data[i] == CAN) {
+            finish(false);
+            return;
+        }
+        // sumę kontrolną albo CRC16 wybiera odbiorca znakiem inicjującym; XMODEM-1K wymaga CRC
+        if (data[i] == NAK) {
+            sender = std::make_unique<XmodemSender<ChecksumPolicy>>(BLOCK_SIZE, std::move(source));
+        } else if (data[i] == C) {
+            sender = std::make_unique<XmodemSender<CRC16Policy>>(oneK ? BLOCK_SIZE_1K : BLOCK_SIZE, std::move(source));
+        } else {
+            continue;
+        }
+        sender->start(now);
+        sender->feed(data.subspan(i + 1), now);
+        forward();
+        return;
+    }
+}
+
+void NegotiatingXmodemSender::expired(Clock::time_point now) {
+    if (sender) {
+        sender->poll(now);
+        forward();
+        return;
+    }
+    if (++retries >= MAX_RETRIES) {
+        finish(false);
+    } else {
+        arm(after(now));
+    }
+}
+
+// Wyjście, termin i wynik nadawcy stają się wyjściem, terminem i wynikiem tej maszyny
+void NegotiatingXmodemSender::forward() {
+    std::vector<uint8_t>& output = sender->output();
+    send(output);
+    output.clear();
+    arm(sender->deadline());
+    if (sender->finished()) {
+        finish(sender->succeeded());
+    }
+}
+
+std::unique_ptr<ProtocolMachine> makeXmodemReceiver(const TransferOptions& options, BlockSink sink) {
+    if (options.crc) {
+        return std::make_unique<XmodemReceiver<CRC16Policy>>(std::move(sink));
+    }
+    return std::make_unique<XmodemReceiver<ChecksumPolicy>>(std::move(sink));
+}
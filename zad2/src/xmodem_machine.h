@@ -0,0 +1,148 @@
+#ifndef XMODEM_MACHINE_H
+#define XMODEM_MACHINE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "protocol_machine.h"
+#include "xmodem.h"
+#include "xmodem_protocol.h"
+
+// Zwykły XMODEM (bloki 128 i 1024 bajtów, każdy potwierdzany osobno) jako maszyny stanów, z zabezpieczeniem
+// bloku jako parametrem szablonu. To jedyna implementacja ramek i powtórzeń tego trybu: pętla zdarzeń
+// demona napędza maszyny bajtami z portu, a blokujące receiveFile/sendFile - odczytami z Transport.
+// Dane nie pochodzą z plików: odbiornik oddaje kolejne bloki do BlockSink, nadawca pobiera dane z BlockSource
+// albo gotowe ramki z PacketSource.
+
+// Dostaje dane każdego nowego bloku (z dopełnieniem 0x1A); false przerywa transmisję
+using BlockSink = std::function<bool(std::span<const uint8_t>)>;
+// Wypełnia bufor danymi i zwraca ich liczbę; mniej niż rozmiar bufora tylko na końcu danych
+using BlockSource = std::function<size_t(std::span<uint8_t>)>;
+// Następna gotowa ramka albo nullptr na końcu danych; poprzednia ramka przestaje być potrzebna
+using PacketSource = std::function<const Packet*()>;
+
+template <typename Policy>
+class XmodemReceiver : public ProtocolMachine {
+public:
+    explicit XmodemReceiver(BlockSink sink);
+
+    // Wysyła znak inicjujący (NAK przy sumie kontrolnej, C przy CRC) i ponawia go do pierwszej ramki
+    void start(Clock::time_point now) override;
+    // Jak start(), gdy znak inicjujący wysłał już ktoś inny, np. blokujące startTransfer
+    void startReceiving(Clock::time_point now);
+    void feed(std::span<const uint8_t> data, Clock::time_point now) override;
+    // Ile początkowych bajtów data należy do bieżącej ramki. Blokujący odbiór podaje maszynie najwyżej
+    // tyle, więc to, co przyszło po ostatniej ramce sesji, zostaje w ReceiveBuffer.
+    size_t frameLength(std::span<const uint8_t> data) const;
+
+protected:
+    void expired(Clock::time_point now) override;
+
+private:
+    enum class State {
+        Starting,
+        Receiving,
+        Purging
+    };
+
+    static size_t frameSizeFor(uint8_t headerByte) {
+        return 3 + blockSizeFor(headerByte) + Policy::trailerSize;
+    }
+
+    void processFrame(std::span<const uint8_t> frame, Clock::time_point now);
+    void corrupted(Clock::time_point now);
+    void reject(Clock::time_point now);
+
+    BlockSink sink;
+    // początek ramki, której reszta jeszcze nie przyszła; całe ramki czytamy wprost z danych feed()
+    std::vector<uint8_t> partial;
+    State state = State::Starting;
+    uint8_t expectedBlock = 1;
+    int attempts = 0;
+    int errors = 0;
+};
+
+// Nadawca po znaku inicjującym: start() od razu wysyła pierwszy blok. Ramki składa sam z danych
+// z BlockSource albo dostaje gotowe z PacketSource. W trybie gathered ramka nie trafia do output() -
+// kto napędza maszynę, zabiera ją przez takeFrame() i wysyła wprost z bufora źródła, także przy
+// powtórce, a odpowiedzi podaje maszynie po jednym bajcie.
+template <typename Policy>
+class XmodemSender : public ProtocolMachine {
+public:
+    XmodemSender(size_t maxBlockSize, BlockSource source);
+    XmodemSender(PacketSource source, bool gathered);
+
+    XmodemSender(const XmodemSender&) = delete;
+    XmodemSender& operator=(const XmodemSender&) = delete;
+
+    void start(Clock::time_point now) override;
+    void feed(std::span<const uint8_t> data, Clock::time_point now) override;
+    // Ramka do wysłania po ostatnim wywołaniu albo nullptr; tylko w trybie gathered
+    const Packet* takeFrame() {
+        return std::exchange(frame, nullptr);
+    }
+    // Odpowiedzi odbiorcy to pojedyncze bajty
+    size_t frameLength(std::span<const uint8_t> data) const {
+        return std::min<size_t>(data.size(), 1);
+    }
+
+protected:
+    void expired(Clock::time_point now) override;
+
+private:
+    enum class State {
+        Sending,
+        EndOfTransmission
+    };
+
+    const Packet* readPacket();
+    void sendNextBlock(Clock::time_point now);
+    void sendFrame(Clock::time_point now);
+    void resend(Clock::time_point now);
+
+    PacketSource source;
+    bool gathered = false;
+    const Packet* packet = nullptr;
+    const Packet* frame = nullptr;
+    // ramki z BlockSource
+    size_t maxBlockSize = 0;
+    BlockSource blocks;
+    std::array<uint8_t, BLOCK_SIZE_1K> block;
+    Packet ownPacket;
+    uint8_t blockNumber = 1;
+    State state = State::Sending;
+    int retries = 0;
+};
+
+// Nadawca, który czeka na znak inicjujący i dopiero według niego tworzy XmodemSender z sumą
+// kontrolną albo CRC16; dalej tylko przekazuje mu bajty i terminy
+class NegotiatingXmodemSender : public ProtocolMachine {
+public:
+    NegotiatingXmodemSender(const TransferOptions& options, BlockSource source);
+
+    void start(Clock::time_point now) override;
+    void feed(std::span<const uint8_t> data, Clock::time_point now) override;
+
+protected:
+    void expired(Clock::time_point now) override;
+
+private:
+    void forward();
+
+    bool oneK;
+    BlockSource source;
+    std::unique_ptr<ProtocolMachine> sender;
+    int retries = 0;
+};
+
+// Odbiornik z zabezpieczeniem według options.crc
+std::unique_ptr<ProtocolMachine> makeXmodemReceiver(const TransferOptions& options, BlockSink sink);
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef XMODEM_PROTOCOL_H
+#define XMODEM_PROTOCOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "crc.h"
+#include "xmodem.h"
+
+// Wspólne elementy ramek XMODEM dla pętli blokujących i maszyn stanów pętli zdarzeń
+
+// Znaki sterujące jako stałe w przestrzeni nazw, a nie makra: jednoliterowe C, G i W nie mogą
+// podmieniać identyfikatorów w nagłówkach dołączanych później
+namespace Control {
+constexpr uint8_t SOH = 0x01;
+constexpr uint8_t STX = 0x02;
+constexpr uint8_t EOT = 0x04;
+constexpr uint8_t ACK = 0x06;
+constexpr uint8_t NAK = 0x15;
+constexpr uint8_t CAN = 0x18;
+constexpr uint8_t C = 0x43;
+constexpr uint8_t G = 0x47;
+constexpr uint8_t W = 0x57;
+constexpr uint8_t RESUME = 0x52;
+constexpr uint8_t CRC32C_REQUEST = 0x33;
+}
+
+inline size_t blockSizeFor(uint8_t headerByte) {
+    return headerByte == Control::STX ? BLOCK_SIZE_1K : BLOCK_SIZE;
+}
+
+// Rozmiar bloku dla dataSize bajtów danych: ostatni krótki fragment idzie zwykłym blokiem SOH,
+// żeby nie dopełniać go do 1024 bajtów
+inline size_t blockSizeForData(size_t dataSize, size_t maxBlockSize) {
+    return dataSize > BLOCK_SIZE ? maxBlockSize : BLOCK_SIZE;
+}
+
+// Zabezpieczenie bloku jako parametr szablonu: rozmiar końcówki ramki i sposób jej liczenia są znane
+// w czasie kompilacji, więc pętle przesyłające bloki nie sprawdzają trybu przy każdej ramce
+struct ChecksumPolicy {
+    static constexpr size_t trailerSize = 1;
+
+    static void store(std::span<const uint8_t> block, uint8_t* trailer) {
+        trailer[0] = calculateChecksum(block);
+    }
+    static bool check(std::span<const uint8_t> block, const uint8_t* trailer) {
+        return trailer[0] == calculateChecksum(block);
+    }
+};
+
+struct CRC16Policy {
+    static constexpr size_t trailerSize = 2;
+
+    static void store(std::span<const uint8_t> block, uint8_t* trailer) {
+        uint16_t crc = calculateCRC16(block);
+        trailer[0] = (crc >> 8) & 0xFF;
+        trailer[1] = crc & 0xFF;
+    }
+    static bool check(std::span<const uint8_t> block, const uint8_t* trailer) {
+        return ((static_cast<uint16_t>(trailer[0]) << 8) | trailer[1]) == calculateCRC16(block);
+    }
+};
+
+struct CRC32CPolicy {
+    static constexpr size_t trailerSize = 4;
+
+    static void store(std::span<const uint8_t> block, uint8_t* trailer) {
+        uint32_t crc = calculateCRC32C(block);
+        for (size_t i = 0; i < trailerSize; ++i) {
+            trailer[i] = (crc >> (24 - 8 * i)) & 0xFF;
+        }
+    }
+    static bool check(std::span<const uint8_t> block, const uint8_t* trailer) {
+        uint32_t received = 0;
+        for (size_t i = 0; i < trailerSize; ++i) {
+            received = (received << 8) | trailer[i];
+        }
+        return received == calculateCRC32C(block);
+    }
+};
+
+// Ramka gotowa do wysłania. Dane bloku nie są kopiowane - nagłówek, blok i końcówka idą do łącza
+// jednym zapisem z trzech buforów, a przy powtórce wysyłamy tę samą ramkę bez ponownego liczenia CRC.
+struct Packet {
+    std::array<uint8_t, 3> header;
+    std::span<const uint8_t> block;
+    std::array<uint8_t, 4> trailer;
+    size_t trailerSize;
+};
+
+template <typename Policy>
+void buildPacket(uint8_t blockNumber, std::span<const uint8_t> block, Packet& packet) {
+    static_assert(Policy::trailerSize <= sizeof(packet.trailer));
+    packet.header = {static_cast<uint8_t>(block.size() == BLOCK_SIZE_1K ? Control::STX : Control::SOH), blockNumber,
+                     static_cast<uint8_t>(255 - blockNumber)};
+    packet.block = block;
+    Policy::store(block, packet.trailer.data());
+    packet.trailerSize = Policy::trailerSize;
+}
+
+#endif
@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <vector>
+
+#include "zmodem.h"
+#include "crc.h"
+#include "receive_buffer.h"
+#include "xmodem.h"
+
+#define ZPAD 0x2A
+#define ZDLE 0x18
+#define ZBIN32 0x43
+
+#define ZRINIT 1
+#define ZFILE 4
+#define ZABORT 7
+#define ZFIN 8
+#define ZRPOS 9
+#define ZDATA 10
+#define ZEOF 11
+#define ZCRC 13
+
+#define ZCRCE 0x68
+#define ZCRCG 0x69
+#define ZCRCW 0x6B
+
+// ZPAD ZDLE ZBIN32, typ, 4 bajty argumentu i CRC-32 z typu oraz argumentu
+#define HEADER_SIZE 12
+// rodzaj i długość (3 bajty) przed danymi, CRC-32 po nich
+#define SUBPACKET_OVERHEAD 7
+
+// W odróżnieniu od ZMODEM nic nie jest escapowane przez ZDLE: podpakiety mają jawną długość, a po
+// błędzie odbiorca odnajduje kolejny nagłówek po jego CRC. Przesunięcia są 32-bitowe, jak w ZMODEM.
+struct Header {
+    uint8_t type;
+    uint32_t argument;
+};
+
+static void storeLE32(uint8_t* out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t loadLE32(const uint8_t* in) {
+    return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+}
+
+static void sendHeader(Transport& link, uint8_t type, uint32_t argument) {
+    std::array<uint8_t, HEADER_SIZE> header = {ZPAD, ZDLE, ZBIN32, type};
+    storeLE32(&header[4], argument);
+    storeLE32(&header[8], calculateCRC32(&header[3], 5));
+    link.write(header.data(), header.size());
+}
+
+// Szuka w buforze nagłówka z poprawnym CRC. Wszystko przed nim, np. resztka strumienia danych
+// wysłana przed ZRPOS, jest po drodze pomijane.
+static bool receiveHeader(ReceiveBuffer& input, Header& header, Transport::Clock::time_point deadline) {
+    std::array<uint8_t, HEADER_SIZE> bytes;
+
+    while (input.fillTo(HEADER_SIZE, deadline)) {
+        if (input[0] == ZPAD && input[1] == ZDLE && input[2] == ZBIN32) {
+            input.copyTo(bytes.data(), 0, HEADER_SIZE);
+            if (loadLE32(&bytes[8]) == calculateCRC32(&bytes[3], 5)) {
+                input.consume(HEADER_SIZE);
+                header = {bytes[3], loadLE32(&bytes[4])};
+                return true;
+            }
+        }
+        input.consume(1);
+    }
+    return false;
+}
+
+static Transport::Clock::time_point headerDeadline() {
+    return Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT);
+}
+
+// Dane podpakietu muszą już leżeć w packet od pozycji 3
+static size_t buildSubpacket(uint8_t kind, size_t length, std::vector<uint8_t>& packet) {
+    packet[0] = kind;
+    packet[1] = length & 0xFF;
+    packet[2] = (length >> 8) & 0xFF;
+    storeLE32(&packet[3 + length], calculateCRC32(packet.data(), 3 + length));
+    return length + SUBPACKET_OVERHEAD;
+}
+
+// Zwraca rodzaj podpakietu albo -1, gdy nie przyszedł w całości lub jest uszkodzony
+static int receiveSubpacket(ReceiveBuffer& input, std::span<uint8_t> data, size_t& length) {
+    if (!input.fillTo(3, headerDeadline())) {
+        return -1;
+    }
+    uint8_t kind = input[0];
+    length = input[1] | input[2] << 8;
+    if ((kind != ZCRCE && kind != ZCRCG && kind != ZCRCW) || length > data.size()) {
+        return -1;
+    }
+
+    size_t total = length + SUBPACKET_OVERHEAD;
+    auto deadline = Transport::Clock::now() + std::chrono::milliseconds(TIMEOUT + TIMEOUT_PER_BYTE * total);
+    if (!input.fillTo(total, deadline)) {
+        return -1;
+    }
+
+    std::array<uint8_t, 3> prefix;
+    std::array<uint8_t, 4> trailer;
+    input.copyTo(prefix.data(), 0, prefix.size());
+    input.copyTo(data.data(), 3, length);
+    input.copyTo(trailer.data(), 3 + length, trailer.size());
+    if (updateCRC32(calculateCRC32(prefix), data.data(), length) != loadLE32(trailer.data())) {
+        return -1;
+    }
+    input.consume(total);
+    return kind;
+}
+
+// CRC-32 pierwszych length bajtów pliku, którym odbiorca sprawdza, czy jego niedokończony plik
+// jest początkiem tego, który wysyłamy
+static uint32_t prefixCRC32(std::istream& file, uint64_t length, std::span<uint8_t> buffer) {
+    file.clear();
+    file.seekg(0);
+    uint32_t crc = 0;
+
+    while (length > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(buffer.size(), length));
+        file.read(reinterpret_cast<char*>(buffer.data()), chunk);
+        size_t bytesRead = file.gcount();
+        if (bytesRead == 0) {
+            break;
+        }
+        crc = updateCRC32(crc, buffer.data(), bytesRead);
+        length -= bytesRead;
+    }
+    return crc;
+}
+
+bool receiveFileZmodem(Transport& link, const std::string& path) {
+    ReceiveBuffer input(link);
+    std::array<uint8_t, ZMODEM_SUBPACKET_SIZE + 1> data;
+    std::span<uint8_t> subpacket(data.data(), ZMODEM_SUBPACKET_SIZE);
+    size_t dataLength = 0;
+    Header header;
+
+    // ZRINIT powtarzamy, dopóki nadawca nie przyśle ZFILE z opisem pliku
+    for (int retries = 0;; ++retries) {
+        if (retries >= MAX_RETRIES) {
+            return false;
+        }
+        sendHeader(link, ZRINIT, 0);
+        if (receiveHeader(input, header, headerDeadline()) && header.type == ZFILE
+            && receiveSubpacket(input, subpacket, dataLength) == ZCRCW) {
+            break;
+        }
+    }
+
+    // opis pliku jak w bloku 0 YMODEM: nazwa, zero, "długość czas_modyfikacji"
+    data[dataLength] = 0;
+    std::string name(reinterpret_cast<const char*>(data.data()));
+    std::istringstream info(reinterpret_cast<const char*>(data.data()) + std::min(name.size() + 1, dataLength));
+    uint64_t length = 0;
+    long long modified = 0;
+    bool hasLength = static_cast<bool>(info >> length);
+    bool hasModified = hasLength && static_cast<bool>(info >> std::oct >> modified);
+
+    // Początek pliku z przerwanej transmisji zostawiamy tylko wtedy, gdy nadawca ma na tych
+    // samych pozycjach te same bajty - inaczej zaczynamy od zera
+    uint64_t position = 0;
+    std::error_code error;
+    uint64_t existing = std::filesystem::file_size(path, error);
+    if (!error && hasLength && existing > 0 && existing <= length && existing <= UINT32_MAX) {
+        std::ifstream partial(path, std::ios::binary);
+        uint32_t localCRC = prefixCRC32(partial, existing, subpacket);
+
+        for (int retries = 0; retries < MAX_RETRIES; ++retries) {
+            sendHeader(link, ZCRC, static_cast<uint32_t>(existing));
+            if (receiveHeader(input, header, headerDeadline()) && header.type == ZCRC) {
+                position = header.argument == localCRC ? existing : 0;
+                break;
+            }
+        }
+    }
+    if (position > 0) {
+        std::cout << "Wznawianie od bajtu " << position << std::endl;
+    }
+
+    std::ofstream output(path, std::ios::binary | (position > 0 ? std::ios::app : std::ios::trunc));
+    if (!output) {
+        sendHeader(link, ZABORT, 0);
+        return false;
+    }
+
+    sendHeader(link, ZRPOS, static_cast<uint32_t>(position));
+    bool inFrame = false;
+    int errors = 0;
+    while (true) {
+        if (!inFrame) {
+            if (!receiveHeader(input, header, headerDeadline())) {
+                if (++errors >= MAX_RETRIES) {
+                    sendHeader(link, ZABORT, 0);
+                    return false;
+                }
+                sendHeader(link, ZRPOS, static_cast<uint32_t>(position));
+                continue;
+            }
+
+            if (header.type == ZDATA && header.argument == position) {
+                inFrame = true;
+            } else if (header.type == ZEOF && header.argument == position) {
+                break;
+            } else if (header.type == ZFILE) {
+                // nadawca nie dostał naszego ZRPOS
+                sendHeader(link, ZRPOS, static_cast<uint32_t>(position));
+            } else if (header.type == ZABORT) {
+                return false;
+            }
+            continue;
+        }
+
+        int kind = receiveSubpacket(input, subpacket, dataLength);
+        if (kind < 0) {
+            // nadawca wróci do position z nowym nagłówkiem ZDATA, resztę strumienia pominie receiveHeader
+            if (++errors >= MAX_RETRIES) {
+                sendHeader(link, ZABORT, 0);
+                return false;
+            }
+            sendHeader(link, ZRPOS, static_cast<uint32_t>(position));
+            inFrame = false;
+            continue;
+        }
+
+        errors = 0;
+        output.write(reinterpret_cast<const char*>(data.data()), dataLength);
+        position += dataLength;
+        inFrame = kind == ZCRCG;
+    }
+
+    output.close();
+    if (output.fail()) {
+        sendHeader(link, ZABORT, 0);
+        return false;
+    }
+    if (hasModified && modified > 0) {
+        auto time = std::chrono::file_clock::from_sys(std::chrono::sys_seconds(std::chrono::seconds(modified)));
+        std::filesystem::last_write_time(path, time, error);
+    }
+
+    // ZRINIT po ZEOF potwierdza nadawcy cały plik, ZFIN kończy sesję. Plik jest już zapisany, więc
+    // czekamy tylko tyle, żeby nadawca zdążył powtórzyć ZEOF, jeśli ZRINIT do niego nie dotarł.
+    sendHeader(link, ZRINIT, 0);
+    auto deadline = Transport::Clock::now() + std::chrono::milliseconds(2 * TIMEOUT);
+    while (receiveHeader(input, header, deadline)) {
+        if (header.type == ZFIN) {
+            sendHeader(link, ZFIN, 0);
+            break;
+        }
+        if (header.type == ZEOF) {
+            sendHeader(link, ZRINIT, 0);
+            deadline = Transport::Clock::now() + std::chrono::milliseconds(2 * TIMEOUT);
+        }
+    }
+    return true;
+}
+
+bool sendFileZmodem(Transport& link, const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::error_code error;
+    uint64_t length = std::filesystem::file_size(path, error);
+    if (!file || error || length > UINT32_MAX) {
+        return false;
+    }
+
+    auto modified = std::chrono::file_clock::to_sys(std::filesystem::last_write_time(path));
+    std::ostringstream info;
+    info << std::filesystem::path(path).filename().string() << '\0' << length << ' ' << std::oct
+         << std::chrono::duration_cast<std::chrono::seconds>(modified.time_since_epoch()).count();
+    std::string description = info.str();
+    if (description.size() > ZMODEM_SUBPACKET_SIZE) {
+        return false;
+    }
+
+    ReceiveBuffer input(link);
+    std::vector<uint8_t> packet(ZMODEM_SUBPACKET_SIZE + SUBPACKET_OVERHEAD);
+    auto sendFileHeader = [&] {
+        sendHeader(link, ZFILE, 0);
+        std::copy(description.begin(), description.end(), packet.begin() + 3);
+        link.write(packet.data(), buildSubpacket(ZCRCW, description.size(), packet));
+    };
+
+    uint64_t position = 0;
+    bool fileOffered = false;
+    bool sending = false;
+    bool endSent = false;
+    int retries = 0;
+    Header header;
+
+    while (true) {
+        if (sending) {
+            file.read(reinterpret_cast<char*>(packet.data() + 3), ZMODEM_SUBPACKET_SIZE);
+            size_t bytesRead = file.gcount();
+            bool last = bytesRead < ZMODEM_SUBPACKET_SIZE;
+            if (link.write(packet.data(), buildSubpacket(last ? ZCRCE : ZCRCG, bytesRead, packet)) < 0) {
+                return false;
+            }
+            position += bytesRead;
+            if (last) {
+                sendHeader(link, ZEOF, static_cast<uint32_t>(position));
+                sending = false;
+                endSent = true;
+            }
+
+            // w trakcie strumienia odbiorca odzywa się tylko po to, żeby cofnąć nas do innego miejsca;
+            // termin Clock::now() nie czeka na łączu, więc pusty bufor nie spowalnia podpakietów
+            if (!receiveHeader(input, header, Transport::Clock::now())) {
+                continue;
+            }
+        } else if (!receiveHeader(input, header, headerDeadline())) {
+            if (++retries >= MAX_RETRIES) {
+                return false;
+            }
+            if (endSent) {
+                sendHeader(link, ZEOF, static_cast<uint32_t>(position));
+            } else if (fileOffered) {
+                sendFileHeader();
+            }
+            continue;
+        }
+
+        retries = 0;
+        switch (header.type) {
+            case ZRINIT:
+                if (endSent) {
+                    // plik potwierdzony; brak odpowiedzi na ZFIN nie jest już błędem
+                    sendHeader(link, ZFIN, 0);
+                    while (receiveHeader(input, header, headerDeadline()) && header.type != ZFIN) {
+                    }
+                    return true;
+                }
+                sendFileHeader();
+                fileOffered = true;
+                break;
+            case ZCRC:
+                sendHeader(link, ZCRC, prefixCRC32(file, header.argument, std::span(packet).subspan(3)));
+                break;
+            case ZRPOS:
+                position = std::min<uint64_t>(header.argument, length);
+                file.clear();
+                file.seekg(static_cast<std::streamoff>(position));
+                sendHeader(link, ZDATA, static_cast<uint32_t>(position));
+                sending = true;
+                endSent = false;
+                break;
+            case ZABORT:
+                return false;
+        }
+    }
+}
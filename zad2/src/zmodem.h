@@ -0,0 +1,16 @@
+#ifndef ZMODEM_H
+#define ZMODEM_H
+
+#include <string>
+
+#include "transport.h"
+
+#define ZMODEM_SUBPACKET_SIZE 1024
+
+// Tryb wzorowany na ZMODEM: dane płyną strumieniem podpakietów z CRC-32 bez czekania na
+// potwierdzenia, a odbiorca po błędzie (albo mając już początek pliku z przerwanej transmisji)
+// podaje nadawcy przesunięcie, od którego ma wznowić.
+bool receiveFileZmodem(Transport& link, const std::string& path);
+bool sendFileZmodem(Transport& link, const std::string& path);
+
+#endif